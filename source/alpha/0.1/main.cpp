@@ -17,51 +17,180 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "zModule.h"
+#include "zKernel.h"
+#include "zPerturb.h"
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
-#include <forward_list>
 
 int SCREEN_WIDTH = 500;
 int SCREEN_HEIGHT = 400;
 double ASPECT_RATIO = ((double)SCREEN_WIDTH)/((double)SCREEN_HEIGHT);
 const char W_TITLE[] = "zMand";
 
-const double X_MIN0 = -2.4, Y_MIN0 = -1.5; //initial complex plane boundaries
-const double VIEW_SPAN0 = 3.0; //initial complex plane view
+const double X_CENTER0 = -0.525, Y_CENTER0 = 0.0; //initial center of the complex plane view
+const double VIEW_SPAN0 = 3.0; //initial complex plane view height
 const double MOVEMENT_FACTOR = 8.0;
 const double ZOOM_FACTOR = 0.2;
-const double RADIUS2 = 4.0;
 const double PRECISION0 = 0.25;
-const double log2_0 = log(2.0);
+const Uint32 MAX_ITERATIONS = 1<<24; //keeps deep zooms from asking for more iterations than a Uint32 holds
+const int MAX_REFERENCES = 32; //reference orbits a deep zoom view may use to correct its glitches
+const Uint64 REFERENCE_CACHE_SIZE = 1<<28; //bytes of reference orbits kept for later views
+const double NUCLEUS_SPAN = 4.0; //view height after zooming to a nucleus, in sizes of its component
+const int TILE_SIZE0 = 64, TILE_SIZE_MIN = 8, TILE_SIZE_MAX = 1024; //side of the tiles threads render at a time, in pixels
+const int PROGRESSIVE_STEP0 = 8; //pixels between the samples of the first pass of a progressive view
 
 Uint8 colorschemeIndex = 0x00;
 const Uint8 num_colorschemes = 7;
-const int PALETTE_SIZE = 256;
 SDL_Color insideColor[num_colorschemes];
 SDL_Color palette1[PALETTE_SIZE];
 SDL_Color palette2[PALETTE_SIZE];
 SDL_Color palette3[PALETTE_SIZE];
-
-double minX = X_MIN0, minY = Y_MIN0; //generic complex plane boundaries
-double span = VIEW_SPAN0; //generic complex plane view
+SDL_Color palette4[PALETTE_SIZE];
+SDL_Color palette5[PALETTE_SIZE];
+SDL_Color palette6[PALETTE_SIZE];
+SDL_Color palette7[PALETTE_SIZE];
+SDL_Color* palettes[num_colorschemes] = {palette1, palette2, palette3, palette4, palette5, palette6, palette7};
+
+zFixed centerX(X_CENTER0, 2), centerY(Y_CENTER0, 2); //center of the complex plane view, exact: it only gains limbs as the view shrinks
+zFloatExp span = VIEW_SPAN0; //complex plane view height
+zDoubleDouble minX, minY; //top left corner of the view being rendered, for the escape-time kernels
+zFloatExp spacing; //distance between its pixels
 double precision = PRECISION0;
+Uint32 maxIterations = PALETTE_SIZE; //iteration budget of the view being rendered
+int engine = ENGINE_DOUBLE; //numeric engine of the current view, with perturbation engines pixels are perturbations of referenceOrbit
+double renderCost = 0.0; //its estimated cost, in scalar double iterations
+Uint32 renderTime = 0; //milliseconds the last view took
+zReferenceCache referenceCache(REFERENCE_CACHE_SIZE);
+const zReferenceOrbit* referenceOrbit = NULL; //from referenceCache
+int referenceX, referenceY; //pixel of the view referenceOrbit is the orbit of
+int approximation = APPROX_SERIES; //how deep zooms skip iterations
+int glitchMode = GLITCH_REFERENCES; //how deep zooms deal with glitches
+zSeries referenceSeries; //iterations of the current view approximated by a series in the perturbations
+zBlaTable referenceBla; //or by bilinear approximations
+std::vector<Uint8> glitchMap; //pixels of the current view glitched in perturbation, row by row
+std::vector<int> blobMap; //glitched pixels numbered by connected blob, -1 for the others
+int correctedBlob = -1; //blob being rendered again with a reference of its own, -1 while the whole view is
 int n_threads = 1; //number of threads used to compute each mandelbrot set view
+zThreadPool workers; //the threads, started once and kept between views
+zTileScheduler tiles; //what they render
+int tileSize = TILE_SIZE0;
+SDL_atomic_t viewGeneration; //bumped by every request for a new view, which cancels the one being rendered
+int renderGeneration = 0; //generation of the view being rendered
+SDL_atomic_t renderedPixels; //of the view being rendered, for the progress indicator
+int renderStep = 1; //pass of the view being rendered: its pixels on the grid renderStep pixels apart, each filling its renderStep x renderStep block
+bool renderRefines = false; //the pass keeps the samples of the one before, on the grid twice as coarse
 bool gauss = false;
+bool laneRefill = false; //escape-time kernels refill vector lanes as soon as their pixel is done (double precision only)
+bool singlePrecision = false; //shallow views may be rendered in single precision: faster, but a few boundary pixels differ
+bool progressive = true; //views are rendered in passes of finer and finer samples, each one presented as it's done
+
+/* The main thread only handles events and presents frames, views are rendered by renderThread from a copy of
+ * what they were asked with: the main thread's view globals above are never read while it renders */
+struct ViewSettings
+{
+	zFixed centerX, centerY;
+	zFloatExp span;
+	int w, h;
+	Uint8 colorschemeIndex;
+	bool gauss;
+	int approximation;
+	int glitchMode;
+	int tileSize;
+	int threads;
+	bool laneRefill;
+	bool singlePrecision;
+	bool progressive;
+	bool screenshot; //rendered into a surface of its own, for take_screenshot()
+	bool nucleus; //zoomed to the nucleus of the lowest period minibrot in view first, for zoomToNucleus()
+} view; //of the view being rendered, renderThread's copy
+
+enum
+{
+	LABEL_TOPLEFT = 0,
+	LABEL_BOTTOMRIGHT,
+	LABEL_THREADS,
+	LABEL_ZOOM,
+	LABEL_PRECISION,
+	LABEL_STATISTICS,
+	LABEL_ENGINE,
+	LABEL_DEEPZOOM, //empty unless perturbation was used
+	NUM_LABELS
+};
+
+SDL_Thread* renderThread = NULL;
+SDL_mutex* frameLock = NULL; //guards everything down to nucleusReady
+SDL_cond* frameRequested = NULL;
+SDL_cond* shotDone = NULL;
+ViewSettings requestedView; //the latest view asked for
+bool renderRequested = false; //and not taken by renderThread yet
+bool renderBusy = false; //renderThread is on a view
+int renderPixels = 1; //pixels of that view
+bool stopRendering = false;
+SDL_Surface* frontSurface = NULL; //last complete frame
+std::string frontLabels[NUM_LABELS]; //and its labels
+bool frameReady = false; //not presented yet
+SDL_Surface* shotSurface = NULL; //screenshot taken by renderThread, NULL if it failed
+bool shotReady = false;
+zFixed nucleusX, nucleusY; //view renderThread zoomed to for zoomToNucleus(), for the main thread to take on
+zFloatExp nucleusSpan;
+int nucleusGeneration; //generation of the request, it's stale once another view is asked for
+bool nucleusReady = false;
+
+struct RenderStats
+{
+	SDL_atomic_t skipped; //pixels inside the main cardioid or the period-2 bulb, never iterated
+	SDL_atomic_t periodic; //pixels whose orbit was found to be periodic, iterated only until then
+	Uint64 approximated; //iterations skipped in deep zooms, under lock
+	SDL_SpinLock lock;
+	int references; //reference orbits used by deep zooms
+	int cachedReferences; //of which found in referenceCache
+	int glitched; //pixels still glitched when they ran out
+} renderStats; //statistics of the last mandelbrot set view
+
+struct GlitchBlob
+{
+	int pixels;
+	double sumX, sumY; //of its pixels, for the centroid
+	int x0, y0, x1, y1; //bounding box
+};
 
 
-bool linear_interpolation(SDL_Color& c, SDL_Color c1, SDL_Color c2, double t);
 void createPalette();
 void printInstructions();
 bool init();
 bool loadMedia();
 void close();
 int RenderMandelbrot(void* ptr);
-void RenderLabels();
+void describeFrame(std::string* labels);
+void RenderLabels(const std::string* labels, int w, int h);
 void RenderAll();
-void MakeThreads(int w, int h);
+void requestView(const ViewSettings& v);
+void PresentFrame(bool zoomRect, int x0, int y0, int x1, int y1);
+bool startRenderThread();
+void stopRenderThread();
+int RenderViews(void* ptr);
+bool RenderFrame(SDL_Surface** surface);
+void PublishPass();
+ViewSettings currentView(int w, int h);
+Uint32 iterationBudget(const zFloatExp& s, double* p);
+bool MakeThreads(int w, int h);
+void RunThreads(int w, int h, int x0, int y0, int x1, int y1);
+void fillBlock(Uint32* pixels, int pitch, int x, int y, int size, const SDL_Rect& clip, Uint32 color);
+bool renderCancelled();
+void prepareReference(int w, int h, int x, int y, int x0, int y0, int x1, int y1);
+int findBlobs(int w, int h, std::vector<GlitchBlob>* blobs);
+void correctGlitches(int w, int h);
 void RenderZoomRect(int x0, int y0, int x1, int y1);
 void MakeZoom(int x0, int y0, int x1, int y1);
+void zoomToNucleus();
+bool findNucleusView();
+void takeNucleusView();
+void viewPoint(int x, int y, int w, int h, zFixed* re, zFixed* im);
+void moveCenter(const zFloatExp& dx, const zFloatExp& dy);
+void fitCenter();
+void resetView();
 void toggle_fullscreen();
 void take_screenshot();
 void save_screenshot(std::string filename);
@@ -69,87 +198,14 @@ void save_screenshot(const char* filename);
 
 zWindow main_window;
 SDL_Renderer* main_renderer = NULL;
-SDL_Surface* screenSurface = NULL;
+SDL_Surface* screenSurface = NULL; //being rendered: renderThread's back buffer, or a screenshot
+SDL_Surface* backSurface = NULL;
 zTexture screenTexture;
 zLabel labelTexture;
 zLabel loadingTexture;
 
 
 
-void gaussian_blur(SDL_Surface* surface)
-{
-	//point = SDL_MapRGBA(format, c.r, c.g, c.b, 0xFF);
-	Uint32* pixels = (Uint32*)(surface->pixels); //Convert pixels to 32 bit
-	Uint32 point_r = 0;
-	Uint32 point_w = 0;
-	Uint8 r = 0;
-	Uint8 g = 0;
-	Uint8 b = 0;
-	Uint8 a = 0;
-	SDL_PixelFormat* format = surface->format;
-	Uint32 pitch = surface->pitch;
-	Uint32 gauss_width = 2;
-	Uint32 sumr = 0;
-	Uint32 sumg = 0;
-	Uint32 sumb = 0;
-	Uint32 gauss_fact[] = {1,1};
-	Uint32 gauss_sum = 2;
-
-	/* orizzontal blurring */
-	for(Uint32 i=1; i<surface->w-1; i++)
-	{
-		for(Uint32 j=1; j<surface->h-1; j++)
-		{
-			sumr = 0;
-			sumg = 0;
-			sumb = 0;
-			for(Uint32 k=0; k<gauss_width; k++)
-			{
-				point_r = pixels[(j * (pitch/4)) + (i - ((gauss_width-1)>>1) + k)]; // reads pixel at (i - ((gauss_width-1)>>1) + k, j)
-				SDL_GetRGBA(point_r, format, &r, &g, &b, &a); // reads rgba from read pixel
-				sumr += ((Uint32)r)*gauss_fact[k];
-				sumg += ((Uint32)g)*gauss_fact[k];
-				sumb += ((Uint32)b)*gauss_fact[k];
-			}
-			point_w = SDL_MapRGBA(format, (Uint8)(sumr/gauss_sum), (Uint8)(sumg/gauss_sum), (Uint8)(sumb/gauss_sum), 0xFF); // gets resulting rgba
-			pixels[j * (pitch/4) + i] = point_w; // and writes it at (i, j)
-		}
-	}
-	/* vertical blurring */
-	for(Uint32 i=1; i<surface->w-1; i++)
-	{
-		for(Uint32 j=1; j<surface->h-1; j++)
-		{
-			sumr = 0;
-			sumg = 0;
-			sumb = 0;
-			for(Uint32 k=0; k<gauss_width; k++)
-			{
-				point_r = pixels[(((j - ((gauss_width-1)>>1) + k)%surface->h) * (pitch/4)) + i]; // reads pixel at (i, j - ((gauss_width-1)>>1) + k)
-				SDL_GetRGBA(point_r, format, &r, &g, &b, &a); // reads rgba from read pixel
-				sumr += ((Uint32)r)*gauss_fact[k];
-				sumg += ((Uint32)g)*gauss_fact[k];
-				sumb += ((Uint32)b)*gauss_fact[k];
-			}
-			point_w = SDL_MapRGBA(format, (Uint8)(sumr/gauss_sum), (Uint8)(sumg/gauss_sum), (Uint8)(sumb/gauss_sum), 0xFF); // gets resulting rgba
-			pixels[j * (pitch/4) + i] = point_w; // and writes it at (i, j)
-		}
-	} 
-}
-
-
-// linear interpolates c1 and c2 with parameter t, saving the result in c
-bool linear_interpolation(SDL_Color* c, SDL_Color c1, SDL_Color c2, double t)
-{
-	if(!((0.0<=t) && (t<=1.0))) // t must be between 0.0 and 1.0
-		return false;
-	c->r = (Uint8)((1.0-t)*c1.r + t*c2.r);
-	c->g = (Uint8)((1.0-t)*c1.g + t*c2.g);
-	c->b = (Uint8)((1.0-t)*c1.b + t*c2.b);
-	return true;
-}
-
-
 void createPalette()
 {
 	// first palette
@@ -209,6 +265,14 @@ void createPalette()
 	}
 	insideColor[2] = {0xFF, 0xFF, 0xFF}; //white
 
+	// red, green, blue and grey ramps
+	for(int i=0; i<PALETTE_SIZE; i++)
+	{
+		palette4[i] = {(Uint8)i, (Uint8)0, (Uint8)0};
+		palette5[i] = {(Uint8)0, (Uint8)i, (Uint8)0};
+		palette6[i] = {(Uint8)0, (Uint8)0, (Uint8)i};
+		palette7[i] = {(Uint8)i, (Uint8)i, (Uint8)i};
+	}
 	insideColor[3] = {0x44, 0x00, 0x00}; //dark red
 
 	insideColor[4] = {0x00, 0x44, 0x00}; //dark green
@@ -228,20 +292,31 @@ void printInstructions()
 	fprintf(stdout, " 'WASD'   - Move view\n");
 	fprintf(stdout, " 'Q'      - Zoom in\n");
 	fprintf(stdout, " 'Z'      - Zoom out\n");
+	fprintf(stdout, " 'N'      - Zoom to the lowest period minibrot in view\n");
 	fprintf(stdout, " 'LEFT'   - Go to previous view [TODO]\n");
 	fprintf(stdout, " 'RIGHT'  - Go to successive view [TODO]\n");
 	fprintf(stdout, " 'UP'     - Increase number of threads\n");
 	fprintf(stdout, " 'DOWN'   - Decrease number of threads\n");
+	fprintf(stdout, " 'PGUP'   - Double the size of the tiles threads take at a time\n");
+	fprintf(stdout, " 'PGDOWN' - Halve the size of the tiles threads take at a time\n");
 	fprintf(stdout, " 'R'      - Reset to standard view\n");
 	fprintf(stdout, " 'X'      - Cicle to next color scheme\n");
 	fprintf(stdout, " 'C'      - Cicle to previous color scheme\n");
 	fprintf(stdout, " 'V'      - Reset to standard color scheme\n");
 	fprintf(stdout, " 'T'      - Toggle gaussian blur\n");
+	fprintf(stdout, " 'P'      - Toggle progressive rendering (coarse passes shown first)\n");
+	fprintf(stdout, " 'L'      - Toggle SIMD lane refill (faster on boundary zooms, double precision kernels only)\n");
+	fprintf(stdout, " 'K'      - Toggle single precision on shallow views (faster, a few boundary pixels differ)\n");
+	fprintf(stdout, " 'B'      - Cycle deep zoom approximation (none, series, BLA)\n");
+	fprintf(stdout, " 'M'      - Toggle deep zoom glitch handling (extra references, rebasing)\n");
 	fprintf(stdout, " 'E'      - Take screenshot\n");
 	fprintf(stdout, " 'F'      - Toggle Fullscreen (will ask for a change in resolution)\n");
 	fprintf(stdout, " 'G'      - Change resolution\n");
 	fprintf(stdout, "Drawing rectangles with mouse can also be used to change view.\n");
 	fprintf(stdout, "The window can be resized and resolution will be changed accordingly.\n");
+	fprintf(stdout, "Run with --isa=generic|sse2|avx2|avx512 to force an instruction set.\n");
+	fprintf(stdout, "Run with --tile=SIZE to start with tiles of SIZE x SIZE pixels.\n\n");
+	fprintf(stdout, "Using %s kernels.\n", isaName(getIsa()));
 }
 
 
@@ -337,8 +412,11 @@ bool loadMedia()
 
 void close()
 {
-	SDL_FreeSurface(screenSurface);
-	screenSurface = NULL;
+	stopRenderThread();
+	workers.free();
+	SDL_FreeSurface(frontSurface);
+	SDL_FreeSurface(backSurface);
+	frontSurface = backSurface = screenSurface = NULL;
 	screenTexture.free();
 	labelTexture.free();
 	loadingTexture.free();
@@ -356,93 +434,148 @@ int RenderMandelbrot(void* ptr)
 {
 	int* data = (int*)ptr;
 	int s_width = data[0];
-	int s_height = data[1];
-	int begin = data[2];
-	int end = data[3];
+	int worker = data[2];
+	int generation = data[3];
 	Uint32* pixels = (Uint32*)(screenSurface->pixels); //Convert pixels to 32 bit
-	Uint32 point = 0;
 	SDL_PixelFormat* format = screenSurface->format;
 	int pitch = screenSurface->pitch;
-	double u, v, re, im, tempRe, modulus2, nu;
-	precision = exp(log10(VIEW_SPAN0/span)/2.0); // sqrt of the exp of the base10 log of the current zoom factor makes sense, right?
-	Uint32 maxIt = (Uint32)(PALETTE_SIZE*precision); // max iterations is proportional to the precision multiplier
-	double spanfactor = span/s_height;
-	SDL_Color c, c1, c2;
-	Uint8 ii, iii;
-
-	for(int y=begin; y<=end; y++)
+	Uint32 maxIt = maxIterations;
+	double spanfactor = spacing.toDouble();
+	double x0 = minX.toDouble(), y0 = minY.toDouble(); //pixels are placed from the edges of the view, not of the tile, so every pass agrees with a full render
+	zFloatExp dcX0 = zFloatExp((double)(-referenceX))*spacing;
+	double* nuRow = new double[s_width]; // smooth iteration counts of the current row
+	Uint32* samples = new Uint32[s_width]; // colors of its samples, before they fill their blocks
+	Uint8* glitchRow = new Uint8[s_width]; // and whether they glitched, before they go to glitchMap
+	int step = renderStep;
+	zKernelStats stats = {0};
+	const zSeries* series = (view.approximation == APPROX_SERIES) ? &referenceSeries : NULL;
+	const zBlaTable* bla = (view.approximation == APPROX_BLA) ? &referenceBla : NULL;
+	const SDL_Color* palette = palettes[view.colorschemeIndex];
+	SDL_Color inside = insideColor[view.colorschemeIndex];
+	bool rebase = (view.glitchMode == GLITCH_REBASE);
+	SDL_Rect tile;
+
+	while(SDL_AtomicGet(&viewGeneration) == generation && tiles.next(worker, &tile)) //a newer view cancels this one between tiles
 	{
-		for(int x=0; x<=s_width; x++)
+		int done = 0;
+		for(int y=tile.y; y<tile.y+tile.h; y+=step)
 		{
-			u = minX + x*spanfactor;
-			v = minY + y*spanfactor;
-			re = u;
-			im = v;
-			tempRe = 0.0;
-			c = insideColor[colorschemeIndex];
-			for(Uint32 i=0; i<maxIt; i++)
+			if(correctedBlob >= 0)
 			{
-				tempRe = re*re - im*im + u;
-				im = re*im*2.0 + v;
-				re = tempRe;
-				if((modulus2 = re*re + im*im) > RADIUS2)
+				/* only the runs of pixels of the blob, see correctGlitches() */
+				int n = tile.w;
+				for(int x=tile.x; x<tile.x+n; )
 				{
-					// http://en.wikipedia.org/wiki/Mandelbrot_set#Continuous_.28smooth.29_coloring/
-					nu = ((double)i) + 1.0 - log(0.5*log(modulus2)/log2_0)/log2_0;
-					ii = ((int)nu)%PALETTE_SIZE;
-					iii = ((int)nu+1)%PALETTE_SIZE;
-					switch(colorschemeIndex)
-					{	// coloring algorithms
-						case 0:
-							c1 = palette1[ii];
-							c2 = palette1[iii];
-							break;
-						case 1:
-							c1 = palette2[ii];
-							c2 = palette2[iii];
-							break;
-						case 2:
-							c1 = palette3[ii];
-							c2 = palette3[iii];
-							break;
-						case 3:
-							c1 = {ii, 0x00, 0x00};
-							c2 = {iii, 0x00, 0x00};
-							break;
-						case 4:
-							c1 = {0x00, ii, 0x00};
-							c2 = {0x00, iii, 0x00};
-							break;
-						case 5:
-							c1 = {0x00, 0x00, ii};
-							c2 = {0x00, 0x00, iii};
-							break;
-						case 6:
-							c1 = {ii, ii, ii};
-							c2 = {iii, iii, iii};
-							break;
+					if(blobMap[y*s_width+x] != correctedBlob)
+					{
+						x++;
+						continue;
 					}
-					linear_interpolation(&c, c1, c2, nu-floor(nu));
-					break;
+					int run = x;
+					while(run < tile.x+n && blobMap[y*s_width+run] == correctedBlob)
+						run++;
+					perturbRow(nuRow, &glitchMap[y*s_width+x], run-x, x, 1, dcX0, zFloatExp((double)(y - referenceY))*spacing, spacing, referenceOrbit, series, bla, maxIt, rebase, &stats);
+					colorRow(pixels + y*(pitch/4) + x, nuRow, run-x, palette, inside, format);
+					x = run;
 				}
+				continue;
 			}
-			point = SDL_MapRGBA(format, c.r, c.g, c.b, 0xFF);
-			pixels[(y * (pitch/4)) + x] = point; //color selected pixel
+
+			/* the samples of the row on the grid of the pass, but those the previous pass left on it */
+			bool kept = renderRefines && (y%(2*step) == 0);
+			int first = kept ? step : 0, stride = kept ? 2*step : step;
+			int n = (tile.w - first + stride-1)/stride;
+			if(kept)
+			{
+				for(int x=tile.x; x<tile.x+tile.w; x+=stride)
+					fillBlock(pixels, pitch, x, y, step, tile, pixels[y*(pitch/4)+x]);
+			}
+			if(n <= 0)
+				continue;
+
+			switch(engine)
+			{
+				case ENGINE_FLOAT:
+					escapeRowFloat(nuRow, n, tile.x+first, stride, x0, y0 + y*spanfactor, spanfactor, maxIt, &stats);
+					break;
+				case ENGINE_DOUBLE:
+					if(view.laneRefill)
+						escapeRowRefill(nuRow, n, tile.x+first, stride, x0, y0 + y*spanfactor, spanfactor, maxIt, &stats);
+					else
+						escapeRow(nuRow, n, tile.x+first, stride, x0, y0 + y*spanfactor, spanfactor, maxIt, &stats);
+					break;
+				case ENGINE_DOUBLEDOUBLE:
+					escapeRowDD(nuRow, n, tile.x+first, stride, minX, minY + y*spanfactor, spanfactor, maxIt, &stats);
+					break;
+				default:
+					perturbRow(nuRow, (stride == 1) ? &glitchMap[y*s_width+tile.x] : glitchRow, n, tile.x+first, stride, dcX0, zFloatExp((double)(y - referenceY))*spacing, spacing, referenceOrbit, series, bla, maxIt, rebase, &stats);
+					for(int i=0; stride > 1 && i<n; i++)
+						glitchMap[y*s_width + tile.x+first + i*stride] = glitchRow[i];
+					break;
+			}
+			if(step == 1 && stride == 1)
+				colorRow(pixels + y*(pitch/4) + tile.x, nuRow, n, palette, inside, format); //color selected row of the tile
+			else
+			{
+				colorRow(samples, nuRow, n, palette, inside, format);
+				for(int i=0; i<n; i++)
+					fillBlock(pixels, pitch, tile.x+first + i*stride, y, step, tile, samples[i]);
+			}
+			done += n;
 		}
+		if(correctedBlob < 0)
+			SDL_AtomicAdd(&renderedPixels, done);
 	}
+	delete[] nuRow;
+	delete[] samples;
+	delete[] glitchRow;
+	SDL_AtomicAdd(&renderStats.skipped, stats.skipped);
+	SDL_AtomicAdd(&renderStats.periodic, stats.periodic);
+	SDL_AtomicLock(&renderStats.lock);
+	renderStats.approximated += stats.approximated;
+	SDL_AtomicUnlock(&renderStats.lock);
 
 	return 0;
 }
 
 
-void RenderLabels()
+void describeFrame(std::string* labels)
+{
+	/* texts of the labels of the view just rendered, for RenderLabels() */
+	char tempBuff[256];
+	double zoom = log10(VIEW_SPAN0) - log2(view.span)*log10(2.0); // base10 log of the zoom factor
+	int digits = (int)fmax(ceil(zoom + log10((double)view.h)) + 2.0, 16.0); // enough to tell pixels apart
+	zFixed re, im;
+
+	viewPoint(0, 0, view.w, view.h, &re, &im);
+	labels[LABEL_TOPLEFT] = "(" + re.toDecimal(digits) + ", " + im.toDecimal(digits) + ")";
+	viewPoint(view.w, view.h, view.w, view.h, &re, &im);
+	labels[LABEL_BOTTOMRIGHT] = "(" + re.toDecimal(digits) + ", " + im.toDecimal(digits) + ")";
+	sprintf(tempBuff, "Threads: %u, tiles: %d px", view.threads, view.tileSize);
+	labels[LABEL_THREADS] = tempBuff;
+	sprintf(tempBuff, "Zoom: %fe%+03d", pow(10.0, zoom - floor(zoom)), (int)floor(zoom)); // past the range of doubles
+	labels[LABEL_ZOOM] = tempBuff;
+	sprintf(tempBuff, "Precision: %f", precision);
+	labels[LABEL_PRECISION] = tempBuff;
+	sprintf(tempBuff, "Skipped: %d px inside cardioid/bulb, %d px periodic", SDL_AtomicGet(&renderStats.skipped), SDL_AtomicGet(&renderStats.periodic));
+	labels[LABEL_STATISTICS] = tempBuff;
+	sprintf(tempBuff, "Engine: %s%s, cost ~%.1e double iterations, %u ms", engineName(engine), (view.laneRefill && engine == ENGINE_DOUBLE) ? " (lane refill)" : "", renderCost, renderTime);
+	labels[LABEL_ENGINE] = tempBuff;
+	labels[LABEL_DEEPZOOM].clear();
+	if(engine >= ENGINE_PERTURB)
+	{
+		sprintf(tempBuff, "Perturbation, %s, %s: %.0f of %u iterations per pixel skipped, %d references (%d cached), %d px glitched", approximationName(view.approximation), glitchModeName(view.glitchMode), (double)renderStats.approximated/((double)view.w*view.h), maxIterations, renderStats.references, renderStats.cachedReferences, renderStats.glitched);
+		labels[LABEL_DEEPZOOM] = tempBuff;
+	}
+}
+
+
+void RenderLabels(const std::string* labels, int w, int h)
 {
-	char tempBuff[100];
 	int dx=10, dy=10;
 
 	//topleft corner label
-	sprintf(tempBuff, "(%+1.16f, %+1.16f)", minX, minY);
-	labelTexture.setText(tempBuff);
+	labelTexture.setText(labels[LABEL_TOPLEFT]);
 	if(!labelTexture.refresh(main_renderer))
 	{
 		fprintf(stderr, "Failed to render topleft corner label texture!\n");
@@ -454,119 +587,537 @@ void RenderLabels()
 	}
 
 	//bottomright corner label
-	sprintf(tempBuff, "(%+1.16f, %+1.16f)", minX+span*ASPECT_RATIO, minY+span);
-	labelTexture.setText(tempBuff);
+	labelTexture.setText(labels[LABEL_BOTTOMRIGHT]);
 	if(!labelTexture.refresh(main_renderer))
 	{
 		fprintf(stderr, "Failed to render bottomright corner label texture!\n");
 	}
 	else
 	{
-		labelTexture.bottomright(SCREEN_WIDTH-dx, SCREEN_HEIGHT-dy);
+		labelTexture.bottomright(w-dx, h-dy);
 		labelTexture.render(main_renderer);
 	}
 
 	//Threads label
-	sprintf(tempBuff, "Threads: %u", n_threads);
-	labelTexture.setText(tempBuff);
+	labelTexture.setText(labels[LABEL_THREADS]);
 	if(!labelTexture.refresh(main_renderer))
 	{
 		fprintf(stderr, "Failed to render threads label texture!\n");
 	}
 	else
 	{
-		labelTexture.topright(SCREEN_WIDTH-dx, dy);
+		labelTexture.topright(w-dx, dy);
 		labelTexture.render(main_renderer);
 	}
 
 	//Zoom label
-	sprintf(tempBuff, "Zoom: %e", VIEW_SPAN0/span);
-	labelTexture.setText(tempBuff);
+	labelTexture.setText(labels[LABEL_ZOOM]);
 	if(!labelTexture.refresh(main_renderer))
 	{
 		fprintf(stderr, "Failed to render zoom label texture!\n");
 	}
 	else
 	{
-		labelTexture.bottomleft(dx, SCREEN_HEIGHT-dy);
+		labelTexture.bottomleft(dx, h-dy);
 		labelTexture.render(main_renderer);
 	}
 
 	//Precision label
 	dy = labelTexture.getHeight()+2*dx;
-	sprintf(tempBuff, "Precision: %f", precision);
-	labelTexture.setText(tempBuff);
+	labelTexture.setText(labels[LABEL_PRECISION]);
 	if(!labelTexture.refresh(main_renderer))
 	{
 		fprintf(stderr, "Failed to render precision label texture!\n");
 	}
 	else
 	{
-		labelTexture.bottomleft(dx, SCREEN_HEIGHT-dy);
+		labelTexture.bottomleft(dx, h-dy);
 		labelTexture.render(main_renderer);
 	}
+
+	//Statistics label
+	dy += labelTexture.getHeight()+dx;
+	labelTexture.setText(labels[LABEL_STATISTICS]);
+	if(!labelTexture.refresh(main_renderer))
+	{
+		fprintf(stderr, "Failed to render statistics label texture!\n");
+	}
+	else
+	{
+		labelTexture.bottomleft(dx, h-dy);
+		labelTexture.render(main_renderer);
+	}
+
+	//Engine label
+	dy += labelTexture.getHeight()+dx;
+	labelTexture.setText(labels[LABEL_ENGINE]);
+	if(!labelTexture.refresh(main_renderer))
+	{
+		fprintf(stderr, "Failed to render engine label texture!\n");
+	}
+	else
+	{
+		labelTexture.bottomleft(dx, h-dy);
+		labelTexture.render(main_renderer);
+	}
+
+	//Deep zoom label
+	if(!labels[LABEL_DEEPZOOM].empty())
+	{
+		dy += labelTexture.getHeight()+dx;
+		labelTexture.setText(labels[LABEL_DEEPZOOM]);
+		if(!labelTexture.refresh(main_renderer))
+		{
+			fprintf(stderr, "Failed to render deep zoom label texture!\n");
+		}
+		else
+		{
+			labelTexture.bottomleft(dx, h-dy);
+			labelTexture.render(main_renderer);
+		}
+	}
 }
 
 
 void RenderAll()
 {
-	/* show 'RENDERING...' */
-	loadingTexture.center_at(SCREEN_WIDTH/2, SCREEN_HEIGHT/2);
-	loadingTexture.render(main_renderer);
-	SDL_RenderPresent(main_renderer);
+	requestView(currentView(SCREEN_WIDTH, SCREEN_HEIGHT));
+}
 
-	/* prepare surface to render current mandelbrot view */
-	SDL_SetRenderDrawColor(main_renderer, insideColor[colorschemeIndex].r, insideColor[colorschemeIndex].g, insideColor[colorschemeIndex].b, 0xFF);
-	SDL_FreeSurface(screenSurface);
-	screenSurface = SDL_CreateRGBSurface(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, 0, 0, 0, 0);
-	if(screenSurface == NULL)
+
+void requestView(const ViewSettings& v)
+{
+	/* hand v to renderThread, dropping the view it's on */
+	SDL_LockMutex(frameLock);
+	requestedView = v;
+	renderRequested = true;
+	SDL_AtomicIncRef(&viewGeneration);
+	SDL_CondSignal(frameRequested);
+	SDL_UnlockMutex(frameLock);
+}
+
+
+void PresentFrame(bool zoomRect, int x0, int y0, int x1, int y1)
+{
+	static int shownProgress = -1;
+	int progress = -1;
+
+	/* a new frame goes into the texture once, with its labels */
+	SDL_LockMutex(frameLock);
+	if(frameReady)
 	{
-		fprintf(stderr, "Unable to create new surface! SDL Error: %s\n", SDL_GetError());
-		return;
+		screenTexture.loadFromSurface(main_renderer, frontSurface, false, insideColor[0], SDL_TEXTUREACCESS_TARGET);
+		screenTexture.setAsRenderTarget(main_renderer);
+		RenderLabels(frontLabels, frontSurface->w, frontSurface->h);
+		SDL_SetRenderTarget(main_renderer, NULL);
+		frameReady = false;
 	}
+	if(renderBusy || renderRequested)
+		progress = renderBusy ? (int)(100.0*SDL_AtomicGet(&renderedPixels)/renderPixels) : 0;
+	SDL_UnlockMutex(frameLock);
 
-	MakeThreads(SCREEN_WIDTH, SCREEN_HEIGHT);
-	if(gauss) gaussian_blur(screenSurface);
-
-	/* show labels, render everything, and take a screenshot for later */
-	screenTexture.loadFromSurface(main_renderer, screenSurface, false, insideColor[0], SDL_TEXTUREACCESS_TARGET);
-	screenTexture.setAsRenderTarget(main_renderer);
-	RenderLabels();
-	SDL_SetRenderTarget(main_renderer, NULL);
+	/* the last complete frame, under what's being drawn and the progress of the next one */
+	SDL_SetRenderDrawColor(main_renderer, insideColor[colorschemeIndex].r, insideColor[colorschemeIndex].g, insideColor[colorschemeIndex].b, 0xFF);
+	SDL_RenderClear(main_renderer);
 	screenTexture.render(main_renderer);
+	if(zoomRect)
+		RenderZoomRect(x0, y0, x1, y1);
+	if(progress >= 0)
+	{
+		if(progress != shownProgress)
+		{
+			char tempBuff[32];
+			sprintf(tempBuff, "RENDERING... %d%%", (progress < 100) ? progress : 99); //glitches may still be corrected
+			loadingTexture.setText(tempBuff);
+			if(!loadingTexture.refresh(main_renderer))
+				fprintf(stderr, "Failed to render 'RENDERING...' texture!\n");
+			shownProgress = progress;
+		}
+		loadingTexture.center_at(SCREEN_WIDTH/2, SCREEN_HEIGHT/2);
+		loadingTexture.render(main_renderer);
+	}
 	SDL_RenderPresent(main_renderer);
 }
 
 
-void MakeThreads(int w, int h)
+bool startRenderThread()
+{
+	frameLock = SDL_CreateMutex();
+	frameRequested = SDL_CreateCond();
+	shotDone = SDL_CreateCond();
+	if(frameLock == NULL || frameRequested == NULL || shotDone == NULL)
+		return false;
+	renderThread = SDL_CreateThread(RenderViews, "render", NULL);
+	return renderThread != NULL;
+}
+
+
+void stopRenderThread()
+{
+	if(renderThread != NULL)
+	{
+		SDL_LockMutex(frameLock);
+		stopRendering = true;
+		SDL_AtomicIncRef(&viewGeneration);
+		SDL_CondSignal(frameRequested);
+		SDL_UnlockMutex(frameLock);
+		SDL_WaitThread(renderThread, NULL);
+		renderThread = NULL;
+	}
+	SDL_DestroyCond(shotDone);
+	SDL_DestroyCond(frameRequested);
+	SDL_DestroyMutex(frameLock);
+	shotDone = frameRequested = NULL;
+	frameLock = NULL;
+}
+
+
+int RenderViews(void* ptr)
+{
+	/* renderThread: the latest view asked for at a time, swapping the frame buffers once it's complete */
+	std::string labels[NUM_LABELS];
+	SDL_LockMutex(frameLock);
+	while(true)
+	{
+		while(!renderRequested && !stopRendering)
+			SDL_CondWait(frameRequested, frameLock);
+		if(stopRendering)
+			break;
+		view = requestedView;
+		renderGeneration = SDL_AtomicGet(&viewGeneration);
+		renderRequested = false;
+		renderBusy = true;
+		renderPixels = view.w*view.h;
+		SDL_AtomicSet(&renderedPixels, 0);
+		SDL_UnlockMutex(frameLock);
+
+		/* the nucleus search can take long too: its result is only taken if nothing else was asked for meanwhile */
+		bool found = !view.nucleus || findNucleusView();
+		if(view.nucleus && found && !renderCancelled())
+		{
+			SDL_LockMutex(frameLock);
+			nucleusX = view.centerX;
+			nucleusY = view.centerY;
+			nucleusSpan = view.span;
+			nucleusGeneration = renderGeneration;
+			nucleusReady = true;
+			SDL_UnlockMutex(frameLock);
+		}
+
+		SDL_Surface* shot = NULL;
+		bool complete = found && !renderCancelled() && RenderFrame(view.screenshot ? &shot : &backSurface);
+		if(complete && !view.screenshot)
+			describeFrame(labels);
+
+		SDL_LockMutex(frameLock);
+		renderBusy = false;
+		if(view.screenshot)
+		{
+			shotSurface = shot;
+			shotReady = true;
+			SDL_CondSignal(shotDone);
+		}
+		else if(complete)
+		{
+			SDL_Surface* t = frontSurface;
+			frontSurface = backSurface;
+			backSurface = t;
+			for(int i=0; i<NUM_LABELS; i++)
+				frontLabels[i].swap(labels[i]);
+			frameReady = true;
+		}
+	}
+	SDL_UnlockMutex(frameLock);
+	return 0;
+}
+
+
+bool RenderFrame(SDL_Surface** surface)
 {
-	/* initialize threads to render current mandelbrot view */
-	int data[n_threads][4];
-	char threadname[10] = {0};
-	std::forward_list<SDL_Thread*> thread_list;
+	/* into *surface, unless it was cancelled: a new one only if the size changed */
+	if(*surface == NULL || (*surface)->w != view.w || (*surface)->h != view.h)
+	{
+		SDL_FreeSurface(*surface);
+		*surface = SDL_CreateRGBSurface(0, view.w, view.h, 32, 0, 0, 0, 0);
+		if(*surface == NULL)
+		{
+			fprintf(stderr, "Unable to create new surface! SDL Error: %s\n", SDL_GetError());
+			return false;
+		}
+	}
+	static int asked = 0; // threads last asked for, not tried again if they couldn't all start
+	if(view.threads != asked)
+	{
+		asked = view.threads;
+		if(!workers.resize(asked))
+			fprintf(stderr, "Could only start %d threads! SDL Error: %s\n", workers.getSize(), SDL_GetError());
+	}
+	screenSurface = *surface;
+	if(!MakeThreads(view.w, view.h))
+		return false;
+	if(view.gauss) gaussian_blur(screenSurface);
+	return true;
+}
+
 
-	int t = h/n_threads;
-	for(int i=0; i<n_threads-1; i++)
+void PublishPass()
+{
+	/* a pass of the view being rendered, handed to the main thread as the frame to show until the next one */
+	std::string labels[NUM_LABELS];
+	describeFrame(labels);
+
+	SDL_LockMutex(frameLock);
+	if(frontSurface == NULL || frontSurface->w != view.w || frontSurface->h != view.h)
+	{
+		SDL_FreeSurface(frontSurface);
+		frontSurface = SDL_CreateRGBSurface(0, view.w, view.h, 32, 0, 0, 0, 0);
+	}
+	if(frontSurface != NULL && SDL_BlitSurface(screenSurface, NULL, frontSurface, NULL) == 0)
+	{
+		for(int i=0; i<NUM_LABELS; i++)
+			frontLabels[i].swap(labels[i]);
+		frameReady = true;
+	}
+	SDL_UnlockMutex(frameLock);
+}
+
+
+ViewSettings currentView(int w, int h)
+{
+	ViewSettings v;
+	v.centerX = centerX;
+	v.centerY = centerY;
+	v.span = span;
+	v.w = w;
+	v.h = h;
+	v.colorschemeIndex = colorschemeIndex;
+	v.gauss = gauss;
+	v.approximation = approximation;
+	v.glitchMode = glitchMode;
+	v.tileSize = tileSize;
+	v.threads = n_threads;
+	v.laneRefill = laneRefill;
+	v.singlePrecision = singlePrecision;
+	v.progressive = progressive;
+	v.screenshot = false;
+	v.nucleus = false;
+	return v;
+}
+
+
+Uint32 iterationBudget(const zFloatExp& s, double* p)
+{
+	*p = exp((log10(VIEW_SPAN0) - log2(s)*log10(2.0))/2.0); // sqrt of the exp of the base10 log of the current zoom factor makes sense, right?
+	return (Uint32)fmin(PALETTE_SIZE*(*p), MAX_ITERATIONS); // max iterations is proportional to the precision multiplier
+}
+
+
+bool MakeThreads(int w, int h)
+{
+	Uint32 start = SDL_GetTicks();
+	SDL_AtomicSet(&renderStats.skipped, 0);
+	SDL_AtomicSet(&renderStats.periodic, 0);
+	renderStats.approximated = 0;
+	renderStats.references = 0;
+	renderStats.cachedReferences = 0;
+	renderStats.glitched = 0;
+
+	maxIterations = iterationBudget(view.span, &precision);
+
+	/* the top left corner for the escape-time kernels, and the cheapest engine that gets the view right */
+	zFixed cornerX, cornerY;
+	viewPoint(0, 0, w, h, &cornerX, &cornerY);
+	minX = cornerX.toDoubleDouble();
+	minY = cornerY.toDoubleDouble();
+	spacing = view.span/zFloatExp((double)h);
+	double spanfactor = spacing.toDouble();
+	double x0 = minX.toDouble(), y0 = minY.toDouble();
+	engine = selectEngine(x0, y0, x0 + w*spanfactor, y0 + h*spanfactor, spacing, w*h, maxIterations, view.singlePrecision, &renderCost);
+
+	/* perturbation starts from the orbit of the center pixel, in fixed point */
+	if(engine >= ENGINE_PERTURB)
+	{
+		glitchMap.assign(w*h, 0);
+		prepareReference(w, h, w/2, h/2, 0, 0, w-1, h-1);
+	}
+
+	/* a progressive view is sampled every PROGRESSIVE_STEP0 pixels first, then twice as finely until it's complete */
+	int coarsest = view.progressive ? PROGRESSIVE_STEP0 : 1;
+	for(renderStep = coarsest; ; renderStep /= 2)
+	{
+		renderRefines = (renderStep < coarsest);
+		RunThreads(w, h, 0, 0, w-1, h-1);
+		if(renderStep == 1 || renderCancelled())
+			break;
+		renderTime = SDL_GetTicks() - start;
+		PublishPass();
+	}
+	renderStep = 1;
+	renderRefines = false;
+
+	if(engine >= ENGINE_PERTURB && view.glitchMode == GLITCH_REFERENCES && !renderCancelled())
+		correctGlitches(w, h);
+	renderTime = SDL_GetTicks() - start;
+	return !renderCancelled();
+}
+
+
+void RunThreads(int w, int h, int x0, int y0, int x1, int y1)
+{
+	/* the workers render [x0, x1]x[y0, y1] of current mandelbrot view a tile at a time: one that runs out of tiles
+	   takes some of another's, so those full of the boundary don't leave the rest waiting */
+	int data[view.threads][4];
+	void* jobs[view.threads];
+	int size = view.tileSize;
+	if(view.progressive) // on the grid of the first pass, whose blocks don't cross tiles
+		size = (size + PROGRESSIVE_STEP0-1)/PROGRESSIVE_STEP0*PROGRESSIVE_STEP0;
+
+	tiles.init(x0, y0, x1, y1, size, view.threads);
+	for(int i=0; i<view.threads; i++)
 	{
 		data[i][0] = w;
 		data[i][1] = h;
-		data[i][2] = i*t;
-		data[i][3] = (i+1)*t-1;
-		sprintf(threadname, "T%u", i);
-		thread_list.emplace_front(SDL_CreateThread(RenderMandelbrot, threadname, (void*)data[i]));
+		data[i][2] = i;
+		data[i][3] = renderGeneration;
+		jobs[i] = (void*)data[i];
+	}
+	workers.run(RenderMandelbrot, jobs, view.threads);
+}
+
+
+void fillBlock(Uint32* pixels, int pitch, int x, int y, int size, const SDL_Rect& clip, Uint32 color)
+{
+	/* the size x size block of the surface with (x, y) as its topleft corner, but what's out of clip */
+	int x1 = (x+size < clip.x+clip.w) ? x+size : clip.x+clip.w;
+	int y1 = (y+size < clip.y+clip.h) ? y+size : clip.y+clip.h;
+	for(int j=y; j<y1; j++)
+	{
+		for(int i=x; i<x1; i++)
+			pixels[j*(pitch/4)+i] = color;
+	}
+}
+
+
+bool renderCancelled()
+{
+	return SDL_AtomicGet(&viewGeneration) != renderGeneration;
+}
+
+
+void prepareReference(int w, int h, int x, int y, int x0, int y0, int x1, int y1)
+{
+	/* the orbit of pixel (x, y), with approximations good for the pixels in [x0, x1]x[y0, y1] */
+	zFixed cr, ci;
+	viewPoint(x, y, w, h, &cr, &ci);
+	int limbs = fractionLimbs(spacing);
+	cr.setLimbs(limbs);
+	ci.setLimbs(limbs);
+	bool cached;
+	referenceOrbit = referenceCache.get(cr, ci, maxIterations, &cached);
+	referenceX = x;
+	referenceY = y;
+	renderStats.references++;
+	renderStats.cachedReferences += cached ? 1 : 0;
+
+	zFloatExp dcX0 = zFloatExp((double)(x0 - x))*spacing, dcY0 = zFloatExp((double)(y0 - y))*spacing;
+	zFloatExp dcX1 = zFloatExp((double)(x1 - x))*spacing, dcY1 = zFloatExp((double)(y1 - y))*spacing;
+	if(view.approximation == APPROX_SERIES)
+	{
+		computeSeries(&referenceSeries, referenceOrbit, dcX0, dcY0, dcX1, dcY1, spacing, maxIterations);
+	}
+	else if(view.approximation == APPROX_BLA)
+	{
+		zFloatExp dx = (dcX0.abs() < dcX1.abs()) ? dcX1 : dcX0; // farthest corner
+		zFloatExp dy = (dcY0.abs() < dcY1.abs()) ? dcY1 : dcY0;
+		computeBla(&referenceBla, referenceOrbit, sqrt(dx*dx + dy*dy));
+	}
+}
+
+
+int findBlobs(int w, int h, std::vector<GlitchBlob>* blobs)
+{
+	/* numbers the 4-connected blobs of glitched pixels in blobMap, flooding each one from its first pixel */
+	std::vector<int> stack;
+	blobMap.assign(w*h, -1);
+	blobs->clear();
+	for(int p=0; p<w*h; p++)
+	{
+		if(!glitchMap[p] || blobMap[p] >= 0)
+			continue;
+		int id = (int)blobs->size();
+		GlitchBlob b = {0, 0.0, 0.0, w, h, -1, -1};
+		blobMap[p] = id;
+		stack.push_back(p);
+		while(!stack.empty())
+		{
+			int q = stack.back();
+			stack.pop_back();
+			int x = q%w, y = q/w;
+			b.pixels++;
+			b.sumX += x;
+			b.sumY += y;
+			b.x0 = (x < b.x0) ? x : b.x0;
+			b.y0 = (y < b.y0) ? y : b.y0;
+			b.x1 = (x > b.x1) ? x : b.x1;
+			b.y1 = (y > b.y1) ? y : b.y1;
+			int next[4] = {(x > 0) ? q-1 : -1, (x < w-1) ? q+1 : -1, (y > 0) ? q-w : -1, (y < h-1) ? q+w : -1};
+			for(int k=0; k<4; k++)
+			{
+				if(next[k] >= 0 && glitchMap[next[k]] && blobMap[next[k]] < 0)
+				{
+					blobMap[next[k]] = id;
+					stack.push_back(next[k]);
+				}
+			}
+		}
+		blobs->push_back(b);
 	}
-	data[n_threads-1][0] = w;
-	data[n_threads-1][1] = h;
-	data[n_threads-1][2] = (n_threads-1)*t;
-	data[n_threads-1][3] = h;
-	sprintf(threadname, "T%u", n_threads-1);
-	thread_list.emplace_front(SDL_CreateThread(RenderMandelbrot, threadname, (void*)data[n_threads-1]));
+	return (int)blobs->size();
+}
+
 
-	for(SDL_Thread* th : thread_list)
+void correctGlitches(int w, int h)
+{
+	/* Glitched pixels only need a reference whose orbit is close to theirs: the largest blob at a time
+	 * is rendered again from the pixel closest to its centroid, which can't glitch itself.
+	 * What's left of it, and the other blobs, wait for the next rounds */
+	std::vector<GlitchBlob> blobs;
+	while(renderStats.references < MAX_REFERENCES && !renderCancelled() && findBlobs(w, h, &blobs) > 0)
 	{
-		SDL_WaitThread(th, NULL);
+		int largest = 0;
+		for(int k=1; k<(int)blobs.size(); k++)
+		{
+			if(blobs[k].pixels > blobs[largest].pixels)
+				largest = k;
+		}
+		const GlitchBlob& b = blobs[largest];
+		double cx = b.sumX/b.pixels, cy = b.sumY/b.pixels;
+		int rx = -1, ry = -1;
+		double best = HUGE_VAL;
+		for(int y=b.y0; y<=b.y1; y++)
+		{
+			for(int x=b.x0; x<=b.x1; x++)
+			{
+				double d = (x-cx)*(x-cx) + (y-cy)*(y-cy);
+				if(blobMap[y*w+x] == largest && d < best)
+				{
+					best = d;
+					rx = x;
+					ry = y;
+				}
+			}
+		}
+
+		prepareReference(w, h, rx, ry, b.x0, b.y0, b.x1, b.y1);
+		correctedBlob = largest;
+		RunThreads(w, h, b.x0, b.y0, b.x1, b.y1);
+		correctedBlob = -1;
+	}
+
+	for(int p=0; p<w*h; p++)
+	{
+		renderStats.glitched += glitchMap[p];
 	}
-	thread_list.clear();
 }
 
 
@@ -575,33 +1126,122 @@ void RenderZoomRect(int x0, int y0, int x1, int y1)
 	int spany = y1-y0;
 	int spanx = (int)spany*ASPECT_RATIO;
 	SDL_Rect ZoomRect = {x0-spanx, y0-spany, spanx*2, spany*2};
-	screenTexture.render(main_renderer);
 	SDL_SetRenderDrawColor(main_renderer, 0xFF, 0xFF, 0x00, 0xFF);
 	SDL_RenderDrawRect(main_renderer, &ZoomRect);
-	SDL_RenderPresent(main_renderer);
 }
 
 
 void MakeZoom(int x0, int y0, int x1, int y1)
 {
-	double ix = (double)x0;
-	double iy = (double)y0;
-	//double fx = (double)x1; // unused variable
-	double fy = (double)y1;
-	double spany = ((fy>=iy) ? (fy-iy) : (iy-fy));
-	double spanx = spany*ASPECT_RATIO;
-	ix = ix-spanx;
-	iy = iy-spany;
-	spanx *= 2.0;
-	spany *= 2.0;
-
-	minX = minX + ix*span/SCREEN_HEIGHT;
-	minY = minY + iy*span/SCREEN_HEIGHT;
-	span = spany*span/SCREEN_HEIGHT;
+	/* the rectangle is centered on (x0, y0), and |y1-y0| pixels high each way */
+	double spany = (double)((y1>=y0) ? (y1-y0) : (y0-y1));
+	if(spany == 0.0) // a click without a drag
+		return;
+	zFloatExp pixel = span/zFloatExp((double)SCREEN_HEIGHT);
+	moveCenter(zFloatExp((double)(x0 - SCREEN_WIDTH/2))*pixel, zFloatExp((double)(y0 - SCREEN_HEIGHT/2))*pixel);
+	span = zFloatExp(2.0*spany)*pixel;
+	fitCenter();
 	RenderAll();
 }
 
 
+void zoomToNucleus()
+{
+	/* renderThread looks for it, the main thread goes on presenting frames meanwhile */
+	ViewSettings v = currentView(SCREEN_WIDTH, SCREEN_HEIGHT);
+	v.nucleus = true;
+	requestView(v);
+}
+
+
+bool findNucleusView()
+{
+	/* the lowest period within the disk through the corners of the view, then its nucleus from the center */
+	double p, aspect = (double)view.w/view.h;
+	Uint32 budget = iterationBudget(view.span, &p);
+	zFloatExp radius = view.span*zFloatExp(0.5*sqrt(1.0 + aspect*aspect));
+	Uint32 period = findPeriod(view.centerX, view.centerY, radius, budget, renderCancelled); //a newer view stops the search
+	zFixed cr(view.centerX), ci(view.centerY);
+	zFloatExp size, dx, dy;
+	if(period == 0 || !findNucleus(&cr, &ci, period, &size, renderCancelled))
+	{
+		if(renderCancelled())
+			return false;
+		fprintf(stdout, "No minibrot found in view within %u iterations\n", budget);
+		return false;
+	}
+
+	/* Newton's method may have gone to another nucleus of the same period */
+	dx = (cr - view.centerX).toFloatExp();
+	dy = (ci - view.centerY).toFloatExp();
+	if(radius < sqrt(dx*dx + dy*dy))
+	{
+		fprintf(stdout, "Nucleus of period %u found out of view, not zooming to it\n", period);
+		return false;
+	}
+	fprintf(stdout, "Zooming to the nucleus of period %u\n", period);
+	view.centerX = cr;
+	view.centerY = ci;
+	view.span = size*zFloatExp(NUCLEUS_SPAN);
+	return true;
+}
+
+
+void takeNucleusView()
+{
+	/* the main thread's view becomes the one findNucleusView() found, as if it had zoomed there itself */
+	SDL_LockMutex(frameLock);
+	if(nucleusReady && SDL_AtomicGet(&viewGeneration) == nucleusGeneration)
+	{
+		centerX = nucleusX;
+		centerY = nucleusY;
+		span = nucleusSpan;
+		fitCenter();
+	}
+	nucleusReady = false;
+	SDL_UnlockMutex(frameLock);
+}
+
+
+void viewPoint(int x, int y, int w, int h, zFixed* re, zFixed* im)
+{
+	/* pixel (x, y) of a w x h view of the one being rendered, whose pixel (w/2, h/2) is the center */
+	zFloatExp pixel = view.span/zFloatExp((double)h);
+	*re = view.centerX;
+	*im = view.centerY;
+	re->setSum(view.centerX, zFixed(zFloatExp((double)(x - w/2))*pixel, view.centerX.getLimbs()));
+	im->setSum(view.centerY, zFixed(zFloatExp((double)(y - h/2))*pixel, view.centerY.getLimbs()));
+}
+
+
+void moveCenter(const zFloatExp& dx, const zFloatExp& dy)
+{
+	/* exact, see fitCenter() */
+	centerX.setSum(centerX, zFixed(dx, centerX.getLimbs()));
+	centerY.setSum(centerY, zFixed(dy, centerY.getLimbs()));
+}
+
+
+void fitCenter()
+{
+	/* moves are doubles times span: bits down to 64 below span (plus guard bits) keep them exact */
+	int limbs = fractionLimbs(span*zFloatExp(1.0, -64));
+	if(limbs > centerX.getLimbs())
+	{
+		centerX.setLimbs(limbs);
+		centerY.setLimbs(limbs);
+	}
+}
+
+
+void resetView()
+{
+	centerX = zFixed(X_CENTER0, 2);
+	centerY = zFixed(Y_CENTER0, 2);
+	span = VIEW_SPAN0;
+}
+
+
 void toggle_fullscreen()
 {
 	if(main_window.isFullScreen())
@@ -639,25 +1279,24 @@ void take_screenshot()
 		s[strlen(s)-1] = '\0';
 	sscanf(s, "%dx%d", &w, &h);
 
-	/* prepare surface to render current mandelbrot view */
-	SDL_SetRenderDrawColor(main_renderer, insideColor[colorschemeIndex].r, insideColor[colorschemeIndex].g, insideColor[colorschemeIndex].b, 0xFF);
-	SDL_FreeSurface(screenSurface);
-	screenSurface = SDL_CreateRGBSurface(0, w, h, 32, 0, 0, 0, 0);
-	if(screenSurface == NULL)
-	{
-		fprintf(stderr, "Unable to create new surface! SDL Error: %s\n", SDL_GetError());
-		return;
-	}
-
 	fprintf(stdout, "Apply gaussian blur? [y, n]\n");
 	int g = getchar();
 	fflush(stdin);
 	fprintf(stdout, "Saving... ");
-	MakeThreads(w, h);
-	if((char)g == 'y')
-	{
-		gaussian_blur(screenSurface);
-	}
+
+	/* renderThread renders current mandelbrot view at w x h instead of the window's, and won't drop it */
+	SDL_LockMutex(frameLock);
+	requestedView = currentView(w, h);
+	requestedView.gauss = ((char)g == 'y');
+	requestedView.progressive = false;
+	requestedView.screenshot = true;
+	renderRequested = true;
+	shotReady = false;
+	SDL_AtomicIncRef(&viewGeneration);
+	SDL_CondSignal(frameRequested);
+	while(!shotReady)
+		SDL_CondWait(shotDone, frameLock);
+	SDL_UnlockMutex(frameLock);
 }
 
 
@@ -670,28 +1309,64 @@ void save_screenshot(std::string filename)
 void save_screenshot(const char* filename)
 {
 	take_screenshot();
-	if(SDL_SaveBMP(screenSurface, filename))
-	{
+	if(shotSurface == NULL || SDL_SaveBMP(shotSurface, filename))
 		fprintf(stderr, "Unable to save screenshot! SDL Error: %s\n", SDL_GetError());
-		return;
-	}
-	fprintf(stdout, "Screenshot saved to %s\n", filename);
+	else
+		fprintf(stdout, "Screenshot saved to %s\n", filename);
+	SDL_FreeSurface(shotSurface);
+	shotSurface = NULL;
+	RenderAll(); // the view the screenshot took the place of
 }
 
 
 
 int main(int argc, char* args[])
 {
+	int isa = detectIsa();
+	for(int i=1; i<argc; i++)
+	{
+		if(strncmp(args[i], "--isa=", 6) == 0)
+		{
+			isa = isaFromName(args[i]+6);
+			if(isa < 0)
+			{
+				fprintf(stderr, "Unknown instruction set '%s'!\n", args[i]+6);
+				isa = detectIsa();
+			}
+			else if(isa > detectIsa())
+			{
+				fprintf(stderr, "Instruction set '%s' is not supported by this machine!\n", args[i]+6);
+			}
+		}
+		else if(strncmp(args[i], "--tile=", 7) == 0)
+		{
+			tileSize = atoi(args[i]+7);
+			if(tileSize < TILE_SIZE_MIN || tileSize > TILE_SIZE_MAX)
+			{
+				fprintf(stderr, "Tiles must be %d to %d pixels wide!\n", TILE_SIZE_MIN, TILE_SIZE_MAX);
+				tileSize = TILE_SIZE0;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option '%s'!\n", args[i]);
+		}
+	}
+	selectIsa(isa);
+
 	if(!init())
 		fprintf(stderr, "Failed to initialize!\n");
 	else
 	{
 		if(!loadMedia())
 			fprintf(stderr, "Failed to load media!\n");
+		else if(!startRenderThread())
+			fprintf(stderr, "Failed to start rendering thread! SDL Error: %s\n", SDL_GetError());
 		else
 		{
 			createPalette();
 			printInstructions();
+			n_threads = SDL_GetCPUCount(); // renderThread starts them with the first view
 			RenderAll();
 			bool quit = false, drawing_rect = false;
 			int imx, imy, fmx, fmy;
@@ -723,39 +1398,37 @@ int main(int argc, char* args[])
 								break;
 
 							case SDLK_w:
-								minY -= span/MOVEMENT_FACTOR; //move camera up
+								moveCenter(zFloatExp(), -(span/MOVEMENT_FACTOR)); //move camera up
 								RenderAll();
 								break;
 							case SDLK_a:
-								minX -= span*ASPECT_RATIO/MOVEMENT_FACTOR; //move camera left
+								moveCenter(-(span*ASPECT_RATIO/MOVEMENT_FACTOR), zFloatExp()); //move camera left
 								RenderAll();
 								break;
 							case SDLK_s:
-								minY += span/MOVEMENT_FACTOR; //move camera down
+								moveCenter(zFloatExp(), span/MOVEMENT_FACTOR); //move camera down
 								RenderAll();
 								break;
 							case SDLK_d:
-								minX += span*ASPECT_RATIO/MOVEMENT_FACTOR; //move camera right
+								moveCenter(span*ASPECT_RATIO/MOVEMENT_FACTOR, zFloatExp()); //move camera right
 								RenderAll();
 								break;
 
-							case SDLK_q: //zoom in
-								minX = (2.0*minX+(1.0-ZOOM_FACTOR)*span*ASPECT_RATIO)/2.0;
-								minY = (2.0*minY+(1.0-ZOOM_FACTOR)*span)/2.0;
-								span *= ZOOM_FACTOR;
+							case SDLK_q: //zoom in, around the center
+								span = span*ZOOM_FACTOR;
+								fitCenter();
 								RenderAll();
 								break;
 							case SDLK_z: //zoom out
-								minX = minX + span*ASPECT_RATIO*(1.0-1.0/ZOOM_FACTOR)/2.0;
-								minY = minY + span*(1.0-1.0/ZOOM_FACTOR)/2.0;
-								span /= ZOOM_FACTOR;
+								span = span/ZOOM_FACTOR;
 								RenderAll();
 								break;
+							case SDLK_n: //zoom to a minibrot
+								zoomToNucleus();
+								break;
 
 							case SDLK_r: //reset to standard view
-								span = VIEW_SPAN0;
-								minY = Y_MIN0;
-								minX = X_MIN0;
+								resetView();
 								RenderAll();
 								break;
 
@@ -779,6 +1452,31 @@ int main(int argc, char* args[])
 								gauss = !gauss;
 								RenderAll();
 								break;
+							case SDLK_p: //toggle progressive rendering
+								progressive = !progressive;
+								RenderAll();
+								break;
+
+							case SDLK_b: //cycle deep zoom approximations
+								if(++approximation == NUM_APPROX)
+									approximation = APPROX_NONE;
+								RenderAll();
+								break;
+
+							case SDLK_m: //cycle deep zoom glitch modes
+								if(++glitchMode == NUM_GLITCH_MODES)
+									glitchMode = GLITCH_REFERENCES;
+								RenderAll();
+								break;
+
+							case SDLK_l: //toggle lane refill
+								laneRefill = !laneRefill;
+								RenderAll();
+								break;
+							case SDLK_k: //toggle single precision
+								singlePrecision = !singlePrecision;
+								RenderAll();
+								break;
 
 							case SDLK_f: //toggle fullscreen
 								toggle_fullscreen();
@@ -810,6 +1508,14 @@ int main(int argc, char* args[])
 								n_threads = ((n_threads>1) ? (n_threads-1) : 1);
 								RenderAll();
 								break;
+							case SDLK_PAGEUP: //bigger tiles
+								tileSize = ((tileSize*2 <= TILE_SIZE_MAX) ? tileSize*2 : TILE_SIZE_MAX);
+								RenderAll();
+								break;
+							case SDLK_PAGEDOWN: //smaller tiles
+								tileSize = ((tileSize/2 >= TILE_SIZE_MIN) ? tileSize/2 : TILE_SIZE_MIN);
+								RenderAll();
+								break;
 						} //SWITCH KEYDOWN END
 					} //KEYDOWN END
 					else if(e.type == SDL_MOUSEBUTTONDOWN)
@@ -829,10 +1535,9 @@ int main(int argc, char* args[])
 				} //EVENTS END
 
 				if(drawing_rect)
-				{
 					SDL_GetMouseState(&fmx, &fmy);
-					RenderZoomRect(imx, imy, fmx, fmy);
-				}
+				takeNucleusView();
+				PresentFrame(drawing_rect, imx, imy, fmx, fmy);
 			} //MAINLOOP END
 		}
 	}
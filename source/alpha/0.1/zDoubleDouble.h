@@ -0,0 +1,168 @@
+/*
+zDoubleDouble, double-double numbers for zMand.
+Copyright (C) 2014  Davide Zagami
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZDOUBLEDOUBLE_H
+#define ZDOUBLEDOUBLE_H
+
+#include <cmath>
+
+#if defined(__FLT_EVAL_METHOD__) && __FLT_EVAL_METHOD__ != 0
+#error "double-double needs doubles rounded once: build with -msse2 -mfpmath=sse (see COMPILE.txt)"
+#endif
+
+
+
+//Unevaluated sum hi + lo of two doubles, with |lo| <= half an ulp of hi: about 106 bits of mantissa.
+//Everything is inline. The error-free transformations below need every double operation rounded once
+//to 53 bits: keep -ffp-contract=off, and SSE2 math on 32 bit x86 (x87 registers round twice).
+struct zDoubleDouble
+{
+	double hi, lo;
+
+	zDoubleDouble() : hi(0.0), lo(0.0) {}
+	zDoubleDouble(double d) : hi(d), lo(0.0) {}
+	zDoubleDouble(double h, double l) : hi(h), lo(l) {} //h and l must already be normalized
+
+	inline double toDouble() const
+	{
+		return hi;
+	}
+
+	inline zDoubleDouble& operator+=(const zDoubleDouble& b);
+	inline zDoubleDouble& operator-=(const zDoubleDouble& b);
+	inline zDoubleDouble& operator*=(const zDoubleDouble& b);
+	inline zDoubleDouble& operator/=(const zDoubleDouble& b);
+};
+
+//a + b exactly, for any a and b
+inline zDoubleDouble twoSum(double a, double b)
+{
+	double s = a + b;
+	double bb = s - a;
+	return zDoubleDouble(s, (a - (s - bb)) + (b - bb));
+}
+
+//Same, for |a| >= |b|
+inline zDoubleDouble quickTwoSum(double a, double b)
+{
+	double s = a + b;
+	return zDoubleDouble(s, b - (s - a));
+}
+
+//a*b exactly
+inline zDoubleDouble twoProduct(double a, double b)
+{
+	double p = a*b;
+#if defined(__FMA__)
+	return zDoubleDouble(p, fma(a, b, -p));
+#else
+	/* Dekker: split both factors in 26 bit halves, whose products are exact */
+	const double split = 134217729.0; //2^27 + 1
+	double t = split*a;
+	double ah = t - (t - a), al = a - ah;
+	t = split*b;
+	double bh = t - (t - b), bl = b - bh;
+	return zDoubleDouble(p, ((ah*bh - p) + ah*bl + al*bh) + al*bl);
+#endif
+}
+
+inline zDoubleDouble operator+(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	/* both parts summed exactly, so that cancellation of the high parts doesn't lose the low ones */
+	zDoubleDouble s = twoSum(a.hi, b.hi);
+	zDoubleDouble t = twoSum(a.lo, b.lo);
+	s = quickTwoSum(s.hi, s.lo + t.hi);
+	return quickTwoSum(s.hi, s.lo + t.lo);
+}
+
+inline zDoubleDouble operator-(const zDoubleDouble& a)
+{
+	return zDoubleDouble(-a.hi, -a.lo);
+}
+
+inline zDoubleDouble operator-(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	return a + (-b);
+}
+
+inline zDoubleDouble operator*(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	zDoubleDouble p = twoProduct(a.hi, b.hi);
+	return quickTwoSum(p.hi, p.lo + (a.hi*b.lo + a.lo*b.hi));
+}
+
+inline zDoubleDouble operator/(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	/* long division, one double digit at a time */
+	double q1 = a.hi/b.hi;
+	zDoubleDouble r = a - b*q1;
+	double q2 = r.hi/b.hi;
+	r = r - b*q2;
+	double q3 = r.hi/b.hi;
+	return quickTwoSum(q1, q2) + q3;
+}
+
+inline zDoubleDouble& zDoubleDouble::operator+=(const zDoubleDouble& b)
+{
+	return *this = *this + b;
+}
+
+inline zDoubleDouble& zDoubleDouble::operator-=(const zDoubleDouble& b)
+{
+	return *this = *this - b;
+}
+
+inline zDoubleDouble& zDoubleDouble::operator*=(const zDoubleDouble& b)
+{
+	return *this = *this * b;
+}
+
+inline zDoubleDouble& zDoubleDouble::operator/=(const zDoubleDouble& b)
+{
+	return *this = *this / b;
+}
+
+//a^2, a bit cheaper than a*a
+inline zDoubleDouble square(const zDoubleDouble& a)
+{
+	zDoubleDouble p = twoProduct(a.hi, a.hi);
+	return quickTwoSum(p.hi, p.lo + 2.0*a.hi*a.lo);
+}
+
+//Comparisons of values
+inline bool operator<(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+inline bool operator>(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	return b < a;
+}
+
+inline bool operator<=(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	return !(b < a);
+}
+
+inline bool operator>=(const zDoubleDouble& a, const zDoubleDouble& b)
+{
+	return !(a < b);
+}
+
+#endif
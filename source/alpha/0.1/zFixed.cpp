@@ -0,0 +1,326 @@
+/*
+zFixed, multiword fixed-point numbers for zMand.
+See zFixed.h for info about copyright.
+*/
+
+#include "zFixed.h"
+#include <cmath>
+#include <cstdio>
+
+const int STACK_LIMBS = 32; //products up to this precision don't touch the heap
+
+
+
+int fractionLimbs(const zFloatExp& spacing)
+{
+	/* 32 guard bits keep rounding errors well below the spacing */
+	int bits = (int)ceil(-log2(spacing)) + 32;
+	int limbs = (bits + LIMB_BITS - 1)/LIMB_BITS;
+	return (limbs < 2) ? 2 : limbs;
+}
+
+
+
+
+zFixed::zFixed()
+{
+	limb.assign(3, 0);
+}
+
+zFixed::zFixed(int limbs)
+{
+	limb.assign(limbs+1, 0);
+}
+
+zFixed::zFixed(double d, int limbs)
+{
+	limb.assign(limbs+1, 0);
+	double x = fabs(d);
+	for(int k=limbs; k>=0; k--)
+	{
+		/* every step is exact: x stays below 2^32 and loses its integer part */
+		limb[k] = (Uint32)floor(x);
+		x = ldexp(x - floor(x), LIMB_BITS);
+	}
+	if(d < 0.0)
+		negate();
+}
+
+zFixed::zFixed(const zFloatExp& f, int limbs)
+{
+	/* the mantissa fits in 2 fraction limbs, shifting then drops what's below the precision */
+	*this = zFixed(f.m, (limbs > 2) ? limbs : 2);
+	shift(f.e);
+	setLimbs(limbs);
+}
+
+zFixed::zFixed(const zDoubleDouble& d, int limbs)
+{
+	*this = zFixed(d.hi, limbs);
+	setSum(*this, zFixed(d.lo, limbs));
+}
+
+int zFixed::getLimbs() const
+{
+	return (int)limb.size()-1;
+}
+
+void zFixed::setLimbs(int limbs)
+{
+	int old = getLimbs();
+	if(limbs > old)
+		limb.insert(limb.begin(), limbs-old, 0);
+	else if(limbs < old)
+		limb.erase(limb.begin(), limb.begin()+(old-limbs));
+}
+
+double zFixed::toDouble() const
+{
+	int n = getLimbs();
+	std::vector<Uint32> m(n+1);
+	magnitude(&m[0], n);
+	double d = 0.0;
+	for(int k=0; k<=n; k++)
+	{
+		d += ldexp((double)m[k], LIMB_BITS*(k-n));
+	}
+	return isNegative() ? -d : d;
+}
+
+zFloatExp zFixed::toFloatExp() const
+{
+	int n = getLimbs();
+	std::vector<Uint32> m(n+1);
+	magnitude(&m[0], n);
+	int k = n;
+	while(k >= 0 && m[k] == 0)
+		k--;
+	if(k < 0)
+		return zFloatExp();
+	double d = (double)m[k];
+	if(k >= 1) d += ldexp((double)m[k-1], -LIMB_BITS);
+	if(k >= 2) d += ldexp((double)m[k-2], -2*LIMB_BITS);
+	return zFloatExp(isNegative() ? -d : d, LIMB_BITS*(k-n));
+}
+
+zDoubleDouble zFixed::toDoubleDouble() const
+{
+	/* what the high part misses, at full precision */
+	double hi = toDouble();
+	zFixed rest(getLimbs());
+	rest.setDifference(*this, zFixed(hi, getLimbs()));
+	return twoSum(hi, rest.toDouble());
+}
+
+std::string zFixed::toDecimal(int digits) const
+{
+	int n = getLimbs();
+	std::vector<Uint32> m(n+1);
+	magnitude(&m[0], n);
+	char integer[16];
+	sprintf(integer, "%c%u.", isNegative() ? '-' : '+', m[n]);
+	std::string s(integer);
+	for(int d=0; d<digits; d++)
+	{
+		/* the next digit is the integer part of ten times the fraction */
+		Uint64 carry = 0;
+		for(int k=0; k<n; k++)
+		{
+			Uint64 t = (Uint64)m[k]*10 + carry;
+			m[k] = (Uint32)t;
+			carry = t >> LIMB_BITS;
+		}
+		s += (char)('0' + carry);
+	}
+	return s;
+}
+
+bool zFixed::isNegative() const
+{
+	return (limb.back() & 0x80000000) != 0;
+}
+
+bool zFixed::isZero() const
+{
+	for(size_t k=0; k<limb.size(); k++)
+	{
+		if(limb[k])
+			return false;
+	}
+	return true;
+}
+
+void zFixed::setSum(const zFixed& a, const zFixed& b)
+{
+	int n = getLimbs(), na = a.getLimbs(), nb = b.getLimbs();
+	Uint64 carry = 0;
+	for(int k=0; k<=n; k++)
+	{
+		/* limb k of this is worth as much as limb k-n+na of a */
+		int ka = k-n+na, kb = k-n+nb;
+		Uint64 t = carry;
+		if(ka >= 0) t += a.limb[ka];
+		if(kb >= 0) t += b.limb[kb];
+		limb[k] = (Uint32)t;
+		carry = t >> LIMB_BITS;
+	}
+}
+
+void zFixed::setDifference(const zFixed& a, const zFixed& b)
+{
+	int n = getLimbs(), na = a.getLimbs(), nb = b.getLimbs();
+	Sint64 borrow = 0;
+	for(int k=0; k<=n; k++)
+	{
+		int ka = k-n+na, kb = k-n+nb;
+		Sint64 t = borrow;
+		if(ka >= 0) t += a.limb[ka];
+		if(kb >= 0) t -= b.limb[kb];
+		limb[k] = (Uint32)t;
+		borrow = (t < 0) ? -1 : 0;
+	}
+}
+
+void zFixed::setProduct(const zFixed& a, const zFixed& b)
+{
+	int n = getLimbs();
+	Uint32 stackBuf[2*(STACK_LIMBS+1)];
+	std::vector<Uint32> heapBuf;
+	Uint32* ma = stackBuf;
+	if(n > STACK_LIMBS)
+	{
+		heapBuf.resize(2*(n+1));
+		ma = &heapBuf[0];
+	}
+	Uint32* mb = ma+n+1;
+	bool negative = a.isNegative() != b.isNegative();
+	a.magnitude(ma, n);
+	b.magnitude(mb, n);
+	setMagnitudeProduct(ma, mb, n, negative);
+}
+
+void zFixed::setSquare(const zFixed& a)
+{
+	int n = getLimbs();
+	Uint32 stackBuf[STACK_LIMBS+1];
+	std::vector<Uint32> heapBuf;
+	Uint32* ma = stackBuf;
+	if(n > STACK_LIMBS)
+	{
+		heapBuf.resize(n+1);
+		ma = &heapBuf[0];
+	}
+	a.magnitude(ma, n);
+	setMagnitudeProduct(ma, ma, n, false);
+}
+
+void zFixed::negate()
+{
+	Uint64 carry = 1;
+	for(size_t k=0; k<limb.size(); k++)
+	{
+		Uint64 t = (Uint64)(~limb[k]) + carry;
+		limb[k] = (Uint32)t;
+		carry = t >> LIMB_BITS;
+	}
+}
+
+void zFixed::shift(int bits)
+{
+	int n = (int)limb.size();
+	Uint32 fill = isNegative() ? 0xFFFFFFFF : 0;
+	std::vector<Uint32> old(limb);
+	int limbs = (bits >= 0) ? bits/LIMB_BITS : -((-bits + LIMB_BITS - 1)/LIMB_BITS); //floor
+	int rest = bits - limbs*LIMB_BITS; //0..31, to the left
+	for(int k=0; k<n; k++)
+	{
+		/* 64 bits of the old value, starting one limb below the one that lands in k */
+		int src = k-limbs;
+		Uint32 hi = (src < 0) ? 0 : ((src < n) ? old[src] : fill);
+		Uint32 lo = (src-1 < 0) ? 0 : ((src-1 < n) ? old[src-1] : fill);
+		limb[k] = (rest == 0) ? hi : ((hi << rest) | (lo >> (LIMB_BITS-rest)));
+	}
+}
+
+zFixed zFixed::operator+(const zFixed& b) const
+{
+	zFixed r(getLimbs());
+	r.setSum(*this, b);
+	return r;
+}
+
+zFixed zFixed::operator-(const zFixed& b) const
+{
+	zFixed r(getLimbs());
+	r.setDifference(*this, b);
+	return r;
+}
+
+zFixed zFixed::operator*(const zFixed& b) const
+{
+	zFixed r(getLimbs());
+	r.setProduct(*this, b);
+	return r;
+}
+
+zFixed zFixed::operator-() const
+{
+	zFixed r(*this);
+	r.negate();
+	return r;
+}
+
+void zFixed::magnitude(Uint32* out, int limbs) const
+{
+	int n = getLimbs();
+	bool negative = isNegative();
+	Uint64 carry = negative ? 1 : 0;
+	/* negate at full precision, then keep the limbs asked for */
+	for(int k=0; k<=n; k++)
+	{
+		Uint32 l = negative ? ~limb[k] : limb[k];
+		Uint64 t = (Uint64)l + carry;
+		carry = t >> LIMB_BITS;
+		int ko = k-n+limbs;
+		if(ko >= 0)
+			out[ko] = (Uint32)t;
+	}
+	for(int ko=0; ko<limbs-n; ko++)
+	{
+		out[ko] = 0;
+	}
+}
+
+void zFixed::setMagnitudeProduct(const Uint32* a, const Uint32* b, int n, bool negative)
+{
+	/* schoolbook product of the n+1 limbs of a and b, keeping limbs n..2n (the product has 2n fraction limbs) */
+	Uint32 stackBuf[2*(STACK_LIMBS+1)];
+	std::vector<Uint32> heapBuf;
+	Uint32* p = stackBuf;
+	if(n > STACK_LIMBS)
+	{
+		heapBuf.resize(2*(n+1));
+		p = &heapBuf[0];
+	}
+	for(int k=0; k<2*(n+1); k++)
+	{
+		p[k] = 0;
+	}
+	for(int i=0; i<=n; i++)
+	{
+		Uint64 carry = 0;
+		for(int j=0; j<=n; j++)
+		{
+			Uint64 t = (Uint64)a[i]*b[j] + p[i+j] + carry;
+			p[i+j] = (Uint32)t;
+			carry = t >> LIMB_BITS;
+		}
+		p[i+n+1] = (Uint32)carry;
+	}
+	for(int k=0; k<=n; k++)
+	{
+		limb[k] = p[k+n];
+	}
+	if(negative)
+		negate();
+}
@@ -0,0 +1,241 @@
+/*
+zFixed, multiword fixed-point numbers for zMand.
+Copyright (C) 2014  Davide Zagami
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZFIXED_H
+#define ZFIXED_H
+
+#include "zFloatExp.h"
+#include "zDoubleDouble.h"
+#include <SDL.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+//Bits of precision of each limb
+const int LIMB_BITS = 32;
+
+//Fraction limbs needed to tell apart points spacing apart (plus guard bits), at least 2
+int fractionLimbs(const zFloatExp& spacing);
+
+
+
+//Signed fixed-point number in two's complement: one integer limb (so |x| < 2^31)
+//and any number of fraction limbs. Results are truncated to the precision of the left operand,
+//operands of different precision are extended or truncated as needed.
+class zFixed
+{
+	public:
+		zFixed();
+		explicit zFixed(int limbs); //zero, with the given number of fraction limbs
+		zFixed(double d, int limbs); //exact, if limbs are enough for d
+		zFixed(const zFloatExp& f, int limbs); //same
+		zFixed(const zDoubleDouble& d, int limbs); //same
+
+		int getLimbs() const;
+		void setLimbs(int limbs); //keeps the value, truncating it if precision is reduced
+
+		double toDouble() const; //rounded toward zero
+		zFloatExp toFloatExp() const; //same, with 64 bits kept
+		zDoubleDouble toDoubleDouble() const;
+		std::string toDecimal(int digits) const; //"+1.2345", with the given digits after the point, truncated
+		bool isNegative() const;
+		bool isZero() const;
+
+		//Operations in place, this = a op b (this may be a or b)
+		void setSum(const zFixed& a, const zFixed& b);
+		void setDifference(const zFixed& a, const zFixed& b);
+		void setProduct(const zFixed& a, const zFixed& b);
+		void setSquare(const zFixed& a);
+		void negate();
+		void shift(int bits); //multiplies by 2^bits
+
+		zFixed operator+(const zFixed& b) const;
+		zFixed operator-(const zFixed& b) const;
+		zFixed operator*(const zFixed& b) const;
+		zFixed operator-() const;
+
+	private:
+		std::vector<Uint32> limb; //limb[0] is the least significant fraction limb, limb.back() the integer part
+
+		template<int N> friend class zFixedN;
+
+		void magnitude(Uint32* out, int limbs) const; //|this| with the given fraction limbs
+		void setMagnitudeProduct(const Uint32* a, const Uint32* b, int n, bool negative);
+};
+
+
+
+//Same as zFixed, with N fraction limbs fixed at compile time: no heap, and loops the compiler can unroll.
+//Only what reference orbits need; results are exactly the same as those of a zFixed with N fraction limbs.
+template<int N>
+class zFixedN
+{
+	public:
+		zFixedN(); //zero
+		explicit zFixedN(const zFixed& x); //truncated or extended to N fraction limbs
+
+		zFixed toFixed() const; //exactly, with N fraction limbs
+		double toDouble() const; //rounded toward zero
+		bool isNegative() const;
+
+		//Operations in place, this = a op b (this may be a or b)
+		void setSum(const zFixedN& a, const zFixedN& b);
+		void setDifference(const zFixedN& a, const zFixedN& b);
+		void setSquare(const zFixedN& a);
+
+	private:
+		Uint32 limb[N+1]; //limb[0] is the least significant fraction limb, limb[N] the integer part
+
+		void magnitude(Uint32* out) const;
+};
+
+template<int N>
+inline zFixedN<N>::zFixedN()
+{
+	for(int k=0; k<=N; k++)
+	{
+		limb[k] = 0;
+	}
+}
+
+template<int N>
+inline zFixedN<N>::zFixedN(const zFixed& x)
+{
+	int n = x.getLimbs();
+	for(int k=0; k<=N; k++)
+	{
+		int kx = k-N+n; //limb k is worth as much as limb kx of x
+		limb[k] = (kx >= 0) ? x.limb[kx] : 0;
+	}
+}
+
+template<int N>
+inline zFixed zFixedN<N>::toFixed() const
+{
+	zFixed x(N);
+	for(int k=0; k<=N; k++)
+	{
+		x.limb[k] = limb[k];
+	}
+	return x;
+}
+
+template<int N>
+inline double zFixedN<N>::toDouble() const
+{
+	/* same rounding as zFixed::toDouble() */
+	Uint32 m[N+1];
+	magnitude(m);
+	double d = 0.0;
+	for(int k=0; k<=N; k++)
+	{
+		d += ldexp((double)m[k], LIMB_BITS*(k-N));
+	}
+	return isNegative() ? -d : d;
+}
+
+template<int N>
+inline bool zFixedN<N>::isNegative() const
+{
+	return (limb[N] & 0x80000000) != 0;
+}
+
+template<int N>
+inline void zFixedN<N>::setSum(const zFixedN& a, const zFixedN& b)
+{
+	Uint64 carry = 0;
+	for(int k=0; k<=N; k++)
+	{
+		Uint64 t = (Uint64)a.limb[k] + b.limb[k] + carry;
+		limb[k] = (Uint32)t;
+		carry = t >> LIMB_BITS;
+	}
+}
+
+template<int N>
+inline void zFixedN<N>::setDifference(const zFixedN& a, const zFixedN& b)
+{
+	Sint64 borrow = 0;
+	for(int k=0; k<=N; k++)
+	{
+		Sint64 t = (Sint64)a.limb[k] - b.limb[k] + borrow;
+		limb[k] = (Uint32)t;
+		borrow = (t < 0) ? -1 : 0;
+	}
+}
+
+template<int N>
+inline void zFixedN<N>::setSquare(const zFixedN& a)
+{
+	Uint32 m[N+1], p[2*(N+1)];
+	a.magnitude(m);
+	for(int k=0; k<2*(N+1); k++)
+	{
+		p[k] = 0;
+	}
+
+	/* products of different limbs appear twice: sum them once, double, then add the squares of the limbs */
+	for(int i=0; i<N; i++)
+	{
+		Uint64 carry = 0;
+		for(int j=i+1; j<=N; j++)
+		{
+			Uint64 t = (Uint64)m[i]*m[j] + p[i+j] + carry;
+			p[i+j] = (Uint32)t;
+			carry = t >> LIMB_BITS;
+		}
+		p[i+N+1] = (Uint32)carry;
+	}
+	Uint32 high = 0;
+	for(int k=0; k<2*(N+1); k++)
+	{
+		Uint32 l = p[k];
+		p[k] = (l << 1) | high;
+		high = l >> (LIMB_BITS-1);
+	}
+	Uint64 carry = 0;
+	for(int i=0; i<=N; i++)
+	{
+		Uint64 t = (Uint64)m[i]*m[i] + p[2*i] + carry;
+		p[2*i] = (Uint32)t;
+		t = (t >> LIMB_BITS) + p[2*i+1];
+		p[2*i+1] = (Uint32)t;
+		carry = t >> LIMB_BITS;
+	}
+
+	/* the square has 2N fraction limbs, keep the top N */
+	for(int k=0; k<=N; k++)
+	{
+		limb[k] = p[k+N];
+	}
+}
+
+template<int N>
+inline void zFixedN<N>::magnitude(Uint32* out) const
+{
+	bool negative = isNegative();
+	Uint64 carry = negative ? 1 : 0;
+	for(int k=0; k<=N; k++)
+	{
+		Uint64 t = (Uint64)(negative ? ~limb[k] : limb[k]) + carry;
+		out[k] = (Uint32)t;
+		carry = t >> LIMB_BITS;
+	}
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+zFloatExp, doubles with a wider exponent for zMand.
+Copyright (C) 2014  Davide Zagami
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZFLOATEXP_H
+#define ZFLOATEXP_H
+
+#include <SDL.h>
+#include <cmath>
+#include <cstring>
+
+//Exponent of zero, low enough to lose every alignment
+const int FLOATEXP_ZERO = -(1<<30);
+
+
+
+//Number m*2^e, with 1 <= |m| < 2 (or m = 0 and e = FLOATEXP_ZERO), for values beyond the range of doubles.
+//Everything is inline: the perturbation kernels iterate with it while differences are too small for doubles.
+struct zFloatExp
+{
+	double m;
+	int e;
+
+	zFloatExp() : m(0.0), e(FLOATEXP_ZERO) {}
+	zFloatExp(double d) : m(d), e(0) { normalize(); }
+	zFloatExp(double mantissa, int exponent) : m(mantissa), e(exponent) { normalize(); }
+
+	//2^k as a double, for -1022 <= k <= 1023
+	static inline double pow2(int k)
+	{
+		Uint64 bits = (Uint64)(k + 1023) << 52;
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		return d;
+	}
+
+	//Moves the exponent of m (any double but infinities and NaNs) into e
+	inline void normalize()
+	{
+		Uint64 bits;
+		memcpy(&bits, &m, sizeof(bits));
+		int biased = (int)((bits >> 52) & 0x7FF);
+		if(biased == 0) //zero or subnormal
+		{
+			if(m == 0.0)
+			{
+				e = FLOATEXP_ZERO;
+				return;
+			}
+			m *= pow2(64);
+			e -= 64;
+			memcpy(&bits, &m, sizeof(bits));
+			biased = (int)((bits >> 52) & 0x7FF);
+		}
+		e += biased - 1023;
+		bits = (bits & 0x800FFFFFFFFFFFFFULL) | ((Uint64)1023 << 52);
+		memcpy(&m, &bits, sizeof(m));
+	}
+
+	inline double toDouble() const
+	{
+		if(e >= -1022 && e <= 1023)
+			return m*pow2(e);
+		return (e > 1023) ? m*HUGE_VAL : ldexp(m, (e < -1100) ? -1100 : e);
+	}
+
+	inline zFloatExp operator*(const zFloatExp& b) const
+	{
+		return zFloatExp(m*b.m, e+b.e);
+	}
+
+	inline zFloatExp operator/(const zFloatExp& b) const
+	{
+		return zFloatExp(m/b.m, e-b.e);
+	}
+
+	inline zFloatExp operator+(const zFloatExp& b) const
+	{
+		/* align the smaller one, it's lost entirely past 64 bits */
+		if(e >= b.e)
+			return (e-b.e > 64) ? *this : zFloatExp(m + b.m*pow2(b.e-e), e);
+		else
+			return (b.e-e > 64) ? b : zFloatExp(b.m + m*pow2(e-b.e), b.e);
+	}
+
+	inline zFloatExp operator-() const
+	{
+		zFloatExp r = *this;
+		r.m = -m;
+		return r;
+	}
+
+	inline zFloatExp operator-(const zFloatExp& b) const
+	{
+		return *this + (-b);
+	}
+
+	inline zFloatExp abs() const
+	{
+		zFloatExp r = *this;
+		r.m = fabs(m);
+		return r;
+	}
+
+	//Comparisons of values (not magnitudes)
+	inline bool operator<(const zFloatExp& b) const
+	{
+		return (*this - b).m < 0.0;
+	}
+
+	inline bool operator>(const zFloatExp& b) const
+	{
+		return b < *this;
+	}
+
+	inline bool operator<=(const zFloatExp& b) const
+	{
+		return !(b < *this);
+	}
+};
+
+//Square root, of a non negative value
+inline zFloatExp sqrt(const zFloatExp& a)
+{
+	return (a.e % 2 == 0) ? zFloatExp(std::sqrt(a.m), a.e/2) : zFloatExp(std::sqrt(2.0*a.m), (a.e-1)/2);
+}
+
+//log2 of a positive value
+inline double log2(const zFloatExp& a)
+{
+	return std::log2(a.m) + a.e;
+}
+
+#endif
@@ -0,0 +1,1886 @@
+/*
+zKernel, escape-time kernels for zMand.
+See zKernel.h for info about copyright.
+*/
+
+#include "zKernel.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define ZKERNEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl")))
+#endif
+
+typedef void (*escapeRowFunc)(double*, int, int, int, double, double, double, Uint32, zKernelStats*);
+typedef void (*escapeRowDDFunc)(double*, int, int, int, const zDoubleDouble&, const zDoubleDouble&, double, Uint32, zKernelStats*);
+typedef void (*colorRowFunc)(Uint32*, const double*, int, const SDL_Color*, SDL_Color, const SDL_PixelFormat*);
+typedef void (*blurFunc)(Uint32*, int, int, int);
+typedef Uint32 (*perturbLanesFunc)(zPerturbLanes*, const double*, const double*, Uint32, Uint32, double);
+
+static void escapeRow_scalar(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRowDD_scalar(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void colorRow_scalar(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format);
+static void gaussian_blur_generic(SDL_Surface* surface);
+static void gaussian_blur_scalar(Uint32* pixels, int w, int h, int stride);
+static Uint32 perturbLanes_scalar(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2);
+
+#if defined(ZKERNEL_X86)
+static void escapeRow_sse2(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_avx2(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_avx512(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_sse2_refill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_avx2_refill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_avx512_refill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_sse2_float(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_avx2_float(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRow_avx512_float(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRowDD_avx2(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void escapeRowDD_avx512(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+static void colorRow_avx2(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format);
+static void colorRow_avx512(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format);
+static void gaussian_blur_sse2(Uint32* pixels, int w, int h, int stride);
+static void gaussian_blur_avx2(Uint32* pixels, int w, int h, int stride);
+static void gaussian_blur_avx512(Uint32* pixels, int w, int h, int stride);
+static Uint32 perturbLanes_avx2(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2);
+static Uint32 perturbLanes_avx512(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2);
+#endif
+
+/* kernels of every level, ISA_GENERIC first */
+static const escapeRowFunc escapeRowTable[NUM_ISA] =
+{
+	escapeRow_scalar,
+#if defined(ZKERNEL_X86)
+	escapeRow_sse2, escapeRow_avx2, escapeRow_avx512
+#endif
+};
+static const escapeRowFunc escapeRowRefillTable[NUM_ISA] =
+{
+	escapeRow_scalar, //a single lane is always busy
+#if defined(ZKERNEL_X86)
+	escapeRow_sse2_refill, escapeRow_avx2_refill, escapeRow_avx512_refill
+#endif
+};
+static const escapeRowFunc escapeRowFloatTable[NUM_ISA] =
+{
+	escapeRow_scalar, //single precision scalar isn't any faster
+#if defined(ZKERNEL_X86)
+	escapeRow_sse2_float, escapeRow_avx2_float, escapeRow_avx512_float
+#endif
+};
+static const escapeRowDDFunc escapeRowDDTable[NUM_ISA] =
+{
+	escapeRowDD_scalar,
+#if defined(ZKERNEL_X86)
+	escapeRowDD_scalar, escapeRowDD_avx2, escapeRowDD_avx512 //the vector kernels need FMA for their exact products
+#endif
+};
+static const colorRowFunc colorRowTable[NUM_ISA] =
+{
+	colorRow_scalar,
+#if defined(ZKERNEL_X86)
+	colorRow_scalar, colorRow_avx2, colorRow_avx512 //no gathers before AVX2, the scalar mapping is as good as it gets
+#endif
+};
+static const blurFunc blurTable[NUM_ISA] =
+{
+	gaussian_blur_scalar,
+#if defined(ZKERNEL_X86)
+	gaussian_blur_sse2, gaussian_blur_avx2, gaussian_blur_avx512
+#endif
+};
+static const perturbLanesFunc perturbLanesTable[NUM_ISA] =
+{
+	perturbLanes_scalar,
+#if defined(ZKERNEL_X86)
+	perturbLanes_scalar, perturbLanes_avx2, perturbLanes_avx512 //two lanes don't pay for sharing the loads
+#endif
+};
+static const int perturbLaneCounts[NUM_ISA] = {1, 1, 4, 8};
+static const char* isaNames[NUM_ISA] = {"generic", "sse2", "avx2", "avx512"};
+
+static int currentIsa = ISA_GENERIC;
+static escapeRowFunc escapeRow_impl = escapeRow_scalar;
+static escapeRowFunc escapeRowRefill_impl = escapeRow_scalar;
+static escapeRowFunc escapeRowFloat_impl = escapeRow_scalar;
+static escapeRowDDFunc escapeRowDD_impl = escapeRowDD_scalar;
+static colorRowFunc colorRow_impl = colorRow_scalar;
+static blurFunc blur_impl = gaussian_blur_scalar;
+static perturbLanesFunc perturbLanes_impl = perturbLanes_scalar;
+
+
+
+
+int detectIsa()
+{
+	int isa = ISA_GENERIC;
+#if defined(ZKERNEL_X86)
+	unsigned int eax, ebx, ecx, edx;
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return isa;
+	if(edx & bit_SSE2)
+		isa = ISA_SSE2;
+	bool fma = (ecx & bit_FMA) != 0;
+
+	/* AVX state must also be enabled by the operating system */
+	if((ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_max(0, NULL) >= 7)
+	{
+		unsigned int xcr0, xcr0_hi;
+		__asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if(((xcr0 & 0x06) == 0x06) && (ebx & bit_AVX2) && fma) //XMM and YMM state
+			isa = ISA_AVX2;
+		if(((xcr0 & 0xE6) == 0xE6) && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW) && (ebx & bit_AVX512VL)) //plus opmask and ZMM state
+			isa = ISA_AVX512;
+	}
+#endif
+	return isa;
+}
+
+int selectIsa(int isa)
+{
+	int best = detectIsa();
+	if(isa < ISA_GENERIC || isa > best)
+		isa = best;
+	currentIsa = isa;
+	escapeRow_impl = escapeRowTable[isa];
+	escapeRowRefill_impl = escapeRowRefillTable[isa];
+	escapeRowFloat_impl = escapeRowFloatTable[isa];
+	escapeRowDD_impl = escapeRowDDTable[isa];
+	colorRow_impl = colorRowTable[isa];
+	blur_impl = blurTable[isa];
+	perturbLanes_impl = perturbLanesTable[isa];
+	return isa;
+}
+
+int getIsa()
+{
+	return currentIsa;
+}
+
+const char* isaName(int isa)
+{
+	return (isa >= ISA_GENERIC && isa < NUM_ISA) ? isaNames[isa] : "unknown";
+}
+
+int isaFromName(const char* name)
+{
+	for(int i=0; i<NUM_ISA; i++)
+	{
+		if(strcmp(name, isaNames[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+double smoothIteration(Uint32 i, double modulus2)
+{
+	// http://en.wikipedia.org/wiki/Mandelbrot_set#Continuous_.28smooth.29_coloring/
+	return ((double)i) + 1.0 - log(0.5*log(modulus2)/log2_0)/log2_0;
+}
+
+void escapeRow(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	escapeRow_impl(nu, n, first, stride, minX, v, spanfactor, maxIt, stats);
+}
+
+void escapeRowRefill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	escapeRowRefill_impl(nu, n, first, stride, minX, v, spanfactor, maxIt, stats);
+}
+
+bool singlePrecisionSuffices(double x0, double y0, double x1, double y1, double spanfactor)
+{
+	/* orbits reach |z| = 2 before escaping, so that's the smallest magnitude to account for */
+	double magnitude = fmax(fmax(fmax(fabs(x0), fabs(x1)), fmax(fabs(y0), fabs(y1))), 2.0);
+	return spanfactor >= FLOAT_MIN_SPACING*magnitude;
+}
+
+void escapeRowFloat(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	escapeRowFloat_impl(nu, n, first, stride, minX, v, spanfactor, maxIt, stats);
+}
+
+bool doubleDoublePrecisionSuffices(double x0, double y0, double x1, double y1, double spanfactor)
+{
+	double magnitude = fmax(fmax(fmax(fabs(x0), fabs(x1)), fmax(fabs(y0), fabs(y1))), 2.0);
+	return spanfactor >= DOUBLEDOUBLE_MIN_SPACING*magnitude;
+}
+
+void escapeRowDD(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	escapeRowDD_impl(nu, n, first, stride, minX, v, spanfactor, maxIt, stats);
+}
+
+void colorRow(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format)
+{
+	/* vector kernels write 8 bit channels directly */
+	if(format->BytesPerPixel == 4 && format->Rloss == 0 && format->Gloss == 0 && format->Bloss == 0)
+		colorRow_impl(pixels, nu, n, palette, inside, format);
+	else
+		colorRow_scalar(pixels, nu, n, palette, inside, format);
+}
+
+void gaussian_blur(SDL_Surface* surface)
+{
+	/* the fast kernels average whole pixels a byte at a time, so every channel must be a whole byte */
+	SDL_PixelFormat* format = surface->format;
+	if(format->BytesPerPixel == 4 && format->Rloss == 0 && format->Gloss == 0 && format->Bloss == 0
+		&& format->Rshift%8 == 0 && format->Gshift%8 == 0 && format->Bshift%8 == 0 && (format->Amask == 0 || format->Aloss == 0))
+		blur_impl((Uint32*)(surface->pixels), surface->w, surface->h, surface->pitch/4);
+	else
+		gaussian_blur_generic(surface);
+}
+
+int perturbLaneCount()
+{
+	return perturbLaneCounts[currentIsa];
+}
+
+Uint32 perturbLanes(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2)
+{
+	return perturbLanes_impl(lanes, Zr, Zi, count, i, tolerance2);
+}
+
+
+
+
+/* Scalar kernels */
+
+// linear interpolates c1 and c2 with parameter t, saving the result in c
+static bool linear_interpolation(SDL_Color* c, SDL_Color c1, SDL_Color c2, double t)
+{
+	if(!((0.0<=t) && (t<=1.0))) // t must be between 0.0 and 1.0
+		return false;
+	c->r = (Uint8)((1.0-t)*c1.r + t*c2.r);
+	c->g = (Uint8)((1.0-t)*c1.g + t*c2.g);
+	c->b = (Uint8)((1.0-t)*c1.b + t*c2.b);
+	return true;
+}
+
+// whether c = x + y*i lies in the main cardioid or in the period-2 bulb, which are entirely inside the set
+static inline bool insideMainComponents(double x, double y)
+{
+	double y2 = y*y;
+	double xq = x - 0.25;
+	double q = xq*xq + y2;
+	return (q*(q + xq) <= 0.25*y2) || ((x + 1.0)*(x + 1.0) + y2 <= 0.0625);
+}
+
+// same, in double-double precision
+static inline bool insideMainComponentsDD(const zDoubleDouble& x, const zDoubleDouble& y)
+{
+	zDoubleDouble y2 = square(y);
+	zDoubleDouble xq = x - 0.25;
+	zDoubleDouble q = square(xq) + y2;
+	return (q*(q + xq) <= 0.25*y2) || (square(x + 1.0) + y2 <= 0.0625);
+}
+
+// first pixel from next on that isn't inside the main components, marking the skipped ones
+static inline int nextPending(double* nu, int next, int n, int first, int stride, double minX, double v, double spanfactor, zKernelStats* stats)
+{
+	while(next < n && insideMainComponents(minX + (first + next*stride)*spanfactor, v))
+	{
+		nu[next++] = NU_INSIDE;
+		stats->skipped++;
+	}
+	return next;
+}
+
+// average of two pixels, byte by byte, rounded down
+static inline Uint32 average_pixel(Uint32 a, Uint32 b)
+{
+	return (a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+static void escapeRow_scalar(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	double u, re, im, tempRe, modulus2, savedRe, savedIm;
+	const double eps = spanfactor*PERIOD_TOLERANCE;
+	Uint32 nextSave;
+
+	for(int x=0; x<n; x++)
+	{
+		u = minX + (first + x*stride)*spanfactor;
+		re = u;
+		im = v;
+		nu[x] = NU_INSIDE;
+		if(insideMainComponents(u, v))
+		{
+			stats->skipped++;
+			continue;
+		}
+		savedRe = re;
+		savedIm = im;
+		nextSave = 1;
+		for(Uint32 i=0; i<maxIt; i++)
+		{
+			tempRe = re*re - im*im + u;
+			im = re*im*2.0 + v;
+			re = tempRe;
+			if((modulus2 = re*re + im*im) > RADIUS2)
+			{
+				nu[x] = smoothIteration(i, modulus2);
+				break;
+			}
+			if(fabs(re - savedRe) < eps && fabs(im - savedIm) < eps) //the orbit came back, it's periodic
+			{
+				stats->periodic++;
+				break;
+			}
+			if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+			{
+				savedRe = re;
+				savedIm = im;
+				nextSave <<= 1;
+			}
+		}
+	}
+}
+
+static void escapeRowDD_scalar(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	zDoubleDouble u, re, im, rr, ii, ri, savedRe, savedIm;
+	const double eps = spanfactor*PERIOD_TOLERANCE;
+	double modulus2;
+	Uint32 nextSave;
+
+	for(int x=0; x<n; x++)
+	{
+		u = minX + (first + x*stride)*spanfactor;
+		re = u;
+		im = v;
+		nu[x] = NU_INSIDE;
+		if(insideMainComponentsDD(u, v))
+		{
+			stats->skipped++;
+			continue;
+		}
+		savedRe = re;
+		savedIm = im;
+		nextSave = 1;
+		for(Uint32 i=0; i<maxIt; i++)
+		{
+			rr = square(re);
+			ii = square(im);
+			ri = re*im;
+			re = (rr - ii) + u;
+			im = zDoubleDouble(2.0*ri.hi, 2.0*ri.lo) + v;
+			if((modulus2 = re.hi*re.hi + im.hi*im.hi) > RADIUS2) //the low parts don't matter this far out
+			{
+				nu[x] = smoothIteration(i, modulus2);
+				break;
+			}
+			if(fabs((re.hi - savedRe.hi) + (re.lo - savedRe.lo)) < eps && fabs((im.hi - savedIm.hi) + (im.lo - savedIm.lo)) < eps) //close high parts subtract exactly
+			{
+				stats->periodic++;
+				break;
+			}
+			if(i+1 == nextSave)
+			{
+				savedRe = re;
+				savedIm = im;
+				nextSave <<= 1;
+			}
+		}
+	}
+}
+
+static Uint32 perturbLanes_scalar(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2)
+{
+	double ar, ai, tempRe, zr, zi, modulus2;
+	Uint32 done = 0;
+
+	for(int l=0; l<PERTURB_LANES; l++)
+	{
+		if(!(lanes->active & (1<<l)))
+			continue;
+		double dzr = lanes->dzr[l], dzi = lanes->dzi[l];
+		const double dcr = lanes->dcr[l], dci = lanes->dci[l];
+		Uint32 k;
+		for(k=0; k<count; k++)
+		{
+			ar = 2.0*Zr[k] + dzr;
+			ai = 2.0*Zi[k] + dzi;
+			tempRe = ar*dzr - ai*dzi + dcr;
+			dzi = ar*dzi + ai*dzr + dci;
+			dzr = tempRe;
+			zr = Zr[k+1] + dzr;
+			zi = Zi[k+1] + dzi;
+			if((modulus2 = zr*zr + zi*zi) > RADIUS2)
+			{
+				lanes->nu[l] = smoothIteration(i+k, modulus2);
+				lanes->active &= ~(1<<l);
+				k++;
+				break;
+			}
+			if(modulus2 < tolerance2*(Zr[k+1]*Zr[k+1] + Zi[k+1]*Zi[k+1]))
+			{
+				lanes->glitched[l] = 1;
+				lanes->active &= ~(1<<l);
+				k++;
+				break;
+			}
+		}
+		lanes->dzr[l] = dzr;
+		lanes->dzi[l] = dzi;
+		if(k > done)
+			done = k;
+	}
+	return done;
+}
+
+static void colorRow_scalar(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format)
+{
+	SDL_Color c;
+	Uint8 ii, iii;
+
+	for(int x=0; x<n; x++)
+	{
+		c = inside;
+		if(nu[x] != NU_INSIDE)
+		{
+			ii = ((int)nu[x])%PALETTE_SIZE;
+			iii = ((int)nu[x]+1)%PALETTE_SIZE;
+			linear_interpolation(&c, palette[ii], palette[iii], nu[x]-floor(nu[x]));
+		}
+		pixels[x] = SDL_MapRGBA(format, c.r, c.g, c.b, 0xFF);
+	}
+}
+
+static void gaussian_blur_generic(SDL_Surface* surface)
+{
+	//point = SDL_MapRGBA(format, c.r, c.g, c.b, 0xFF);
+	Uint32* pixels = (Uint32*)(surface->pixels); //Convert pixels to 32 bit
+	Uint32 point_r = 0;
+	Uint32 point_w = 0;
+	Uint8 r = 0;
+	Uint8 g = 0;
+	Uint8 b = 0;
+	Uint8 a = 0;
+	SDL_PixelFormat* format = surface->format;
+	Uint32 pitch = surface->pitch;
+	Uint32 gauss_width = 2;
+	Uint32 sumr = 0;
+	Uint32 sumg = 0;
+	Uint32 sumb = 0;
+	Uint32 gauss_fact[] = {1,1};
+	Uint32 gauss_sum = 2;
+
+	/* orizzontal blurring */
+	for(Uint32 i=1; i<surface->w-1; i++)
+	{
+		for(Uint32 j=1; j<surface->h-1; j++)
+		{
+			sumr = 0;
+			sumg = 0;
+			sumb = 0;
+			for(Uint32 k=0; k<gauss_width; k++)
+			{
+				point_r = pixels[(j * (pitch/4)) + (i - ((gauss_width-1)>>1) + k)]; // reads pixel at (i - ((gauss_width-1)>>1) + k, j)
+				SDL_GetRGBA(point_r, format, &r, &g, &b, &a); // reads rgba from read pixel
+				sumr += ((Uint32)r)*gauss_fact[k];
+				sumg += ((Uint32)g)*gauss_fact[k];
+				sumb += ((Uint32)b)*gauss_fact[k];
+			}
+			point_w = SDL_MapRGBA(format, (Uint8)(sumr/gauss_sum), (Uint8)(sumg/gauss_sum), (Uint8)(sumb/gauss_sum), 0xFF); // gets resulting rgba
+			pixels[j * (pitch/4) + i] = point_w; // and writes it at (i, j)
+		}
+	}
+	/* vertical blurring */
+	for(Uint32 i=1; i<surface->w-1; i++)
+	{
+		for(Uint32 j=1; j<surface->h-1; j++)
+		{
+			sumr = 0;
+			sumg = 0;
+			sumb = 0;
+			for(Uint32 k=0; k<gauss_width; k++)
+			{
+				point_r = pixels[(((j - ((gauss_width-1)>>1) + k)%surface->h) * (pitch/4)) + i]; // reads pixel at (i, j - ((gauss_width-1)>>1) + k)
+				SDL_GetRGBA(point_r, format, &r, &g, &b, &a); // reads rgba from read pixel
+				sumr += ((Uint32)r)*gauss_fact[k];
+				sumg += ((Uint32)g)*gauss_fact[k];
+				sumb += ((Uint32)b)*gauss_fact[k];
+			}
+			point_w = SDL_MapRGBA(format, (Uint8)(sumr/gauss_sum), (Uint8)(sumg/gauss_sum), (Uint8)(sumb/gauss_sum), 0xFF); // gets resulting rgba
+			pixels[j * (pitch/4) + i] = point_w; // and writes it at (i, j)
+		}
+	}
+}
+
+/*
+The blur averages each pixel with its right neighbour, then with the one below it, on every
+pixel but the borders. Rows are processed left to right and top to bottom, so a pixel is always
+averaged with a neighbour that hasn't been overwritten yet, the same as gaussian_blur_generic().
+The vector versions load both operands before storing, which keeps that order.
+*/
+static void gaussian_blur_scalar(Uint32* pixels, int w, int h, int stride)
+{
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(int i=1; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+1]);
+	}
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(int i=1; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+stride]);
+	}
+}
+
+
+
+
+/*
+The vector kernels iterate a group of consecutive pixels together, with exactly the same
+operations (and rounding) as the scalar kernel. Each lane is masked off when it escapes,
+remembering the iteration and |z|^2 it escaped with; the group is done when all lanes are.
+
+The _refill variants don't wait for the whole group: every lane counts its own iterations,
+and as soon as its pixel escapes or reaches maxIt the result is written out and the lane
+is loaded with the next pixel of the row. Lanes only go idle at the end of the row.
+
+The _float variants do the same in single precision, with twice the lanes. They are only
+used on shallow views (see singlePrecisionSuffices()), and only when asked for (see selectEngine()):
+rounding c to floats moves a few boundary pixels to other iteration counts. Iteration counts
+are low there and groups finish together anyway, so they don't refill.
+
+The _dd variants iterate in double-double precision with the same operations as the scalar
+kernel: their exact products come from FMA rather than Dekker's split, the result is the same.
+They are grouped like the plain kernels. Starting points (and the main components check)
+are computed lane by lane with the scalar double-double code.
+*/
+
+#if defined(ZKERNEL_X86)
+
+/* SSE2 kernels */
+
+TARGET_SSE2
+static void escapeRow_sse2(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m128d radius2 = _mm_set1_pd(RADIUS2);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d eps = _mm_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	const __m128d vv = _mm_set1_pd(v);
+	const __m128d lane = _mm_set_pd(1.0, 0.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d quarter = _mm_set1_pd(0.25);
+	const __m128d sixteenth = _mm_set1_pd(0.0625);
+	const __m128d y2 = _mm_set1_pd(v*v);
+	const __m128d qy2 = _mm_set1_pd(0.25*v*v);
+	double escIt[2], escM2[2];
+
+	for(int x0=0; x0<n; x0+=2)
+	{
+		__m128d xx = _mm_add_pd(_mm_set1_pd((double)x0), lane);
+		__m128d px = _mm_add_pd(_mm_set1_pd((double)first), _mm_mul_pd(xx, _mm_set1_pd((double)stride))); //exact, as in escapeRow_scalar
+		__m128d u = _mm_add_pd(_mm_set1_pd(minX), _mm_mul_pd(px, _mm_set1_pd(spanfactor)));
+		__m128d re = u;
+		__m128d im = vv;
+		__m128d it = _mm_setzero_pd();
+		__m128d m2esc = _mm_setzero_pd();
+		__m128d savedRe = re, savedIm = im;
+		__m128d periodic = _mm_setzero_pd();
+		Uint32 nextSave = 1;
+		__m128d active = _mm_cmplt_pd(xx, _mm_set1_pd((double)n)); //lanes past the end of the row never run
+
+		__m128d xq = _mm_sub_pd(u, quarter);
+		__m128d q = _mm_add_pd(_mm_mul_pd(xq, xq), y2);
+		__m128d xb = _mm_add_pd(u, one);
+		__m128d skipped = _mm_and_pd(_mm_or_pd(_mm_cmple_pd(_mm_mul_pd(q, _mm_add_pd(q, xq)), qy2), _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(xb, xb), y2), sixteenth)), active); //inside the main cardioid or the period-2 bulb
+		active = _mm_andnot_pd(skipped, active);
+		stats->skipped += __builtin_popcount(_mm_movemask_pd(skipped));
+
+		if(_mm_movemask_pd(active)) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m128d tempRe = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im)), u);
+				im = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(re, im), two), vv);
+				re = tempRe;
+				__m128d m2 = _mm_add_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im));
+				__m128d esc = _mm_and_pd(_mm_cmpgt_pd(m2, radius2), active);
+				if(_mm_movemask_pd(esc))
+				{
+					it = _mm_or_pd(_mm_andnot_pd(esc, it), _mm_and_pd(esc, _mm_set1_pd((double)i)));
+					m2esc = _mm_or_pd(_mm_andnot_pd(esc, m2esc), _mm_and_pd(esc, m2));
+					active = _mm_andnot_pd(esc, active);
+					if(!_mm_movemask_pd(active))
+						break;
+				}
+				__m128d cycle = _mm_and_pd(_mm_and_pd(_mm_cmplt_pd(_mm_and_pd(_mm_sub_pd(re, savedRe), absMask), eps), _mm_cmplt_pd(_mm_and_pd(_mm_sub_pd(im, savedIm), absMask), eps)), active); //the orbit came back, it's periodic
+				if(_mm_movemask_pd(cycle))
+				{
+					periodic = _mm_or_pd(periodic, cycle);
+					active = _mm_andnot_pd(cycle, active);
+					if(!_mm_movemask_pd(active))
+						break;
+				}
+				if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+				{
+					savedRe = re;
+					savedIm = im;
+					nextSave <<= 1;
+				}
+			}
+		}
+
+		stats->periodic += __builtin_popcount(_mm_movemask_pd(periodic));
+		int stillActive = _mm_movemask_pd(_mm_or_pd(_mm_or_pd(active, skipped), periodic));
+		_mm_storeu_pd(escIt, it);
+		_mm_storeu_pd(escM2, m2esc);
+		for(int l=0; l<2 && x0+l<n; l++)
+		{
+			nu[x0+l] = (stillActive & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+TARGET_SSE2
+static void escapeRow_sse2_refill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m128d radius2 = _mm_set1_pd(RADIUS2);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d vv = _mm_set1_pd(v);
+	const __m128d maxItv = _mm_set1_pd((double)maxIt);
+	const __m128d eps = _mm_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	double ua[2], rea[2], ima[2], ita[2], m2a[2], sra[2], sia[2], nsa[2];
+	int pixel[2];
+	int active = 0, next = 0;
+
+	if(maxIt == 0)
+	{
+		escapeRow_scalar(nu, n, first, stride, minX, v, spanfactor, maxIt, stats); //nothing to refill
+		return;
+	}
+
+	for(int l=0; l<2; l++)
+	{
+		next = nextPending(nu, next, n, first, stride, minX, v, spanfactor, stats);
+		ua[l] = rea[l] = minX + (first + next*stride)*spanfactor;
+		ima[l] = v;
+		ita[l] = 0.0;
+		sra[l] = rea[l];
+		sia[l] = v;
+		nsa[l] = 1.0;
+		pixel[l] = next;
+		if(next < n)
+		{
+			active |= 1<<l;
+			next++;
+		}
+	}
+	__m128d u = _mm_loadu_pd(ua), re = _mm_loadu_pd(rea), im = _mm_loadu_pd(ima), it = _mm_loadu_pd(ita);
+	__m128d savedRe = _mm_loadu_pd(sra), savedIm = _mm_loadu_pd(sia), nextSave = _mm_loadu_pd(nsa);
+
+	while(active)
+	{
+		__m128d tempRe = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im)), u);
+		im = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(re, im), two), vv);
+		re = tempRe;
+		__m128d m2 = _mm_add_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im));
+		it = _mm_add_pd(it, one);
+		int esc = _mm_movemask_pd(_mm_cmpgt_pd(m2, radius2)) & active;
+		int cycle = _mm_movemask_pd(_mm_and_pd(_mm_cmplt_pd(_mm_and_pd(_mm_sub_pd(re, savedRe), absMask), eps), _mm_cmplt_pd(_mm_and_pd(_mm_sub_pd(im, savedIm), absMask), eps))) & active & ~esc; //the orbit came back, it's periodic
+		int done = (esc | cycle | _mm_movemask_pd(_mm_cmpge_pd(it, maxItv))) & active;
+		__m128d save = _mm_cmpeq_pd(it, nextSave); //Brent: each lane's saved point moves forward at every power of two
+		savedRe = _mm_or_pd(_mm_andnot_pd(save, savedRe), _mm_and_pd(save, re));
+		savedIm = _mm_or_pd(_mm_andnot_pd(save, savedIm), _mm_and_pd(save, im));
+		nextSave = _mm_or_pd(_mm_andnot_pd(save, nextSave), _mm_and_pd(save, _mm_add_pd(nextSave, nextSave)));
+		if(done)
+		{
+			_mm_storeu_pd(ua, u);
+			_mm_storeu_pd(rea, re);
+			_mm_storeu_pd(ima, im);
+			_mm_storeu_pd(ita, it);
+			_mm_storeu_pd(m2a, m2);
+			_mm_storeu_pd(sra, savedRe);
+			_mm_storeu_pd(sia, savedIm);
+			_mm_storeu_pd(nsa, nextSave);
+			for(int l=0; l<2; l++)
+			{
+				if(!(done & (1<<l)))
+					continue;
+				nu[pixel[l]] = (esc & (1<<l)) ? smoothIteration((Uint32)ita[l]-1, m2a[l]) : NU_INSIDE;
+				if(cycle & (1<<l))
+					stats->periodic++;
+				next = nextPending(nu, next, n, first, stride, minX, v, spanfactor, stats);
+				if(next < n)
+				{
+					ua[l] = rea[l] = minX + (first + next*stride)*spanfactor;
+					ima[l] = v;
+					ita[l] = 0.0;
+					sra[l] = rea[l];
+					sia[l] = v;
+					nsa[l] = 1.0;
+					pixel[l] = next++;
+				}
+				else
+				{
+					active &= ~(1<<l);
+				}
+			}
+			u = _mm_loadu_pd(ua);
+			re = _mm_loadu_pd(rea);
+			im = _mm_loadu_pd(ima);
+			it = _mm_loadu_pd(ita);
+			savedRe = _mm_loadu_pd(sra);
+			savedIm = _mm_loadu_pd(sia);
+			nextSave = _mm_loadu_pd(nsa);
+		}
+	}
+}
+
+TARGET_SSE2
+static void escapeRow_sse2_float(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m128 radius2 = _mm_set1_ps((float)RADIUS2);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 eps = _mm_set1_ps((float)(spanfactor*PERIOD_TOLERANCE));
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 vv = _mm_set1_ps((float)v);
+	const __m128i lane = _mm_set_epi32(3, 2, 1, 0);
+	const __m128i laneBit = _mm_set_epi32(8, 4, 2, 1);
+	float ua[4], escM2[4];
+	int escIt[4];
+
+	for(int x0=0; x0<n; x0+=4)
+	{
+		int skipped = 0;
+		for(int l=0; l<4; l++)
+		{
+			ua[l] = (float)(minX + (first + (x0+l)*stride)*spanfactor);
+			if(x0+l < n && insideMainComponents(minX + (first + (x0+l)*stride)*spanfactor, v)) //inside the main cardioid or the period-2 bulb
+				skipped |= 1<<l;
+		}
+		stats->skipped += __builtin_popcount(skipped);
+		__m128 u = _mm_loadu_ps(ua);
+		__m128 re = u;
+		__m128 im = vv;
+		__m128i it = _mm_setzero_si128();
+		__m128 m2esc = _mm_setzero_ps();
+		__m128 savedRe = re, savedIm = im;
+		__m128 periodic = _mm_setzero_ps();
+		Uint32 nextSave = 1;
+		__m128 active = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x0), lane), _mm_set1_epi32(n))); //lanes past the end of the row never run
+		active = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(skipped), laneBit), laneBit)), active);
+
+		if(_mm_movemask_ps(active)) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m128 tempRe = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im)), u);
+				im = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(re, im), two), vv);
+				re = tempRe;
+				__m128 m2 = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+				__m128 esc = _mm_and_ps(_mm_cmpgt_ps(m2, radius2), active);
+				if(_mm_movemask_ps(esc))
+				{
+					__m128i esci = _mm_castps_si128(esc);
+					it = _mm_or_si128(_mm_andnot_si128(esci, it), _mm_and_si128(esci, _mm_set1_epi32((int)i)));
+					m2esc = _mm_or_ps(_mm_andnot_ps(esc, m2esc), _mm_and_ps(esc, m2));
+					active = _mm_andnot_ps(esc, active);
+					if(!_mm_movemask_ps(active))
+						break;
+				}
+				__m128 cycle = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(re, savedRe), absMask), eps), _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(im, savedIm), absMask), eps)), active); //the orbit came back, it's periodic
+				if(_mm_movemask_ps(cycle))
+				{
+					periodic = _mm_or_ps(periodic, cycle);
+					active = _mm_andnot_ps(cycle, active);
+					if(!_mm_movemask_ps(active))
+						break;
+				}
+				if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+				{
+					savedRe = re;
+					savedIm = im;
+					nextSave <<= 1;
+				}
+			}
+		}
+
+		stats->periodic += __builtin_popcount(_mm_movemask_ps(periodic));
+		int stillActive = _mm_movemask_ps(_mm_or_ps(active, periodic)) | skipped;
+		_mm_storeu_si128((__m128i*)escIt, it);
+		_mm_storeu_ps(escM2, m2esc);
+		for(int l=0; l<4 && x0+l<n; l++)
+		{
+			nu[x0+l] = (stillActive & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+TARGET_SSE2
+static inline __m128i average_pixels_sse2(__m128i a, __m128i b)
+{
+	/* _mm_avg_epu8 rounds up, take the odd bit back */
+	return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+TARGET_SSE2
+static void gaussian_blur_sse2(Uint32* pixels, int w, int h, int stride)
+{
+	int i;
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(i=1; i+4<=w-1; i+=4)
+			_mm_storeu_si128((__m128i*)(row+i), average_pixels_sse2(_mm_loadu_si128((__m128i*)(row+i)), _mm_loadu_si128((__m128i*)(row+i+1))));
+		for(; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+1]);
+	}
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(i=1; i+4<=w-1; i+=4)
+			_mm_storeu_si128((__m128i*)(row+i), average_pixels_sse2(_mm_loadu_si128((__m128i*)(row+i)), _mm_loadu_si128((__m128i*)(row+i+stride))));
+		for(; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+stride]);
+	}
+}
+
+
+
+
+/* AVX2 kernels */
+
+TARGET_AVX2
+static void escapeRow_avx2(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m256d radius2 = _mm256_set1_pd(RADIUS2);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d eps = _mm256_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	const __m256d vv = _mm256_set1_pd(v);
+	const __m256d lane = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d sixteenth = _mm256_set1_pd(0.0625);
+	const __m256d y2 = _mm256_set1_pd(v*v);
+	const __m256d qy2 = _mm256_set1_pd(0.25*v*v);
+	double escIt[4], escM2[4];
+
+	for(int x0=0; x0<n; x0+=4)
+	{
+		__m256d xx = _mm256_add_pd(_mm256_set1_pd((double)x0), lane);
+		__m256d px = _mm256_add_pd(_mm256_set1_pd((double)first), _mm256_mul_pd(xx, _mm256_set1_pd((double)stride))); //exact, as in escapeRow_scalar
+		__m256d u = _mm256_add_pd(_mm256_set1_pd(minX), _mm256_mul_pd(px, _mm256_set1_pd(spanfactor)));
+		__m256d re = u;
+		__m256d im = vv;
+		__m256d it = _mm256_setzero_pd();
+		__m256d m2esc = _mm256_setzero_pd();
+		__m256d savedRe = re, savedIm = im;
+		__m256d periodic = _mm256_setzero_pd();
+		Uint32 nextSave = 1;
+		__m256d active = _mm256_cmp_pd(xx, _mm256_set1_pd((double)n), _CMP_LT_OQ); //lanes past the end of the row never run
+
+		__m256d xq = _mm256_sub_pd(u, quarter);
+		__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), y2);
+		__m256d xb = _mm256_add_pd(u, one);
+		__m256d skipped = _mm256_and_pd(_mm256_or_pd(_mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)), qy2, _CMP_LE_OQ), _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(xb, xb), y2), sixteenth, _CMP_LE_OQ)), active); //inside the main cardioid or the period-2 bulb
+		active = _mm256_andnot_pd(skipped, active);
+		stats->skipped += __builtin_popcount(_mm256_movemask_pd(skipped));
+
+		if(!_mm256_testz_pd(active, active)) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m256d tempRe = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im)), u);
+				im = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(re, im), two), vv);
+				re = tempRe;
+				__m256d m2 = _mm256_add_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im));
+				__m256d esc = _mm256_and_pd(_mm256_cmp_pd(m2, radius2, _CMP_GT_OQ), active);
+				if(!_mm256_testz_pd(esc, esc))
+				{
+					it = _mm256_blendv_pd(it, _mm256_set1_pd((double)i), esc);
+					m2esc = _mm256_blendv_pd(m2esc, m2, esc);
+					active = _mm256_andnot_pd(esc, active);
+					if(_mm256_testz_pd(active, active))
+						break;
+				}
+				__m256d cycle = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(re, savedRe), absMask), eps, _CMP_LT_OQ), _mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(im, savedIm), absMask), eps, _CMP_LT_OQ)), active); //the orbit came back, it's periodic
+				if(!_mm256_testz_pd(cycle, cycle))
+				{
+					periodic = _mm256_or_pd(periodic, cycle);
+					active = _mm256_andnot_pd(cycle, active);
+					if(_mm256_testz_pd(active, active))
+						break;
+				}
+				if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+				{
+					savedRe = re;
+					savedIm = im;
+					nextSave <<= 1;
+				}
+			}
+		}
+
+		stats->periodic += __builtin_popcount(_mm256_movemask_pd(periodic));
+		int stillActive = _mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(active, skipped), periodic));
+		_mm256_storeu_pd(escIt, it);
+		_mm256_storeu_pd(escM2, m2esc);
+		for(int l=0; l<4 && x0+l<n; l++)
+		{
+			nu[x0+l] = (stillActive & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+TARGET_AVX2
+static void escapeRow_avx2_refill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m256d radius2 = _mm256_set1_pd(RADIUS2);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d vv = _mm256_set1_pd(v);
+	const __m256d maxItv = _mm256_set1_pd((double)maxIt);
+	const __m256d eps = _mm256_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	double ua[4], rea[4], ima[4], ita[4], m2a[4], sra[4], sia[4], nsa[4];
+	int pixel[4];
+	int active = 0, next = 0;
+
+	if(maxIt == 0)
+	{
+		escapeRow_scalar(nu, n, first, stride, minX, v, spanfactor, maxIt, stats); //nothing to refill
+		return;
+	}
+
+	for(int l=0; l<4; l++)
+	{
+		next = nextPending(nu, next, n, first, stride, minX, v, spanfactor, stats);
+		ua[l] = rea[l] = minX + (first + next*stride)*spanfactor;
+		ima[l] = v;
+		ita[l] = 0.0;
+		sra[l] = rea[l];
+		sia[l] = v;
+		nsa[l] = 1.0;
+		pixel[l] = next;
+		if(next < n)
+		{
+			active |= 1<<l;
+			next++;
+		}
+	}
+	__m256d u = _mm256_loadu_pd(ua), re = _mm256_loadu_pd(rea), im = _mm256_loadu_pd(ima), it = _mm256_loadu_pd(ita);
+	__m256d savedRe = _mm256_loadu_pd(sra), savedIm = _mm256_loadu_pd(sia), nextSave = _mm256_loadu_pd(nsa);
+
+	while(active)
+	{
+		__m256d tempRe = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im)), u);
+		im = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(re, im), two), vv);
+		re = tempRe;
+		__m256d m2 = _mm256_add_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im));
+		it = _mm256_add_pd(it, one);
+		int esc = _mm256_movemask_pd(_mm256_cmp_pd(m2, radius2, _CMP_GT_OQ)) & active;
+		int cycle = _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(re, savedRe), absMask), eps, _CMP_LT_OQ), _mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(im, savedIm), absMask), eps, _CMP_LT_OQ))) & active & ~esc; //the orbit came back, it's periodic
+		int done = (esc | cycle | _mm256_movemask_pd(_mm256_cmp_pd(it, maxItv, _CMP_GE_OQ))) & active;
+		__m256d save = _mm256_cmp_pd(it, nextSave, _CMP_EQ_OQ); //Brent: each lane's saved point moves forward at every power of two
+		savedRe = _mm256_blendv_pd(savedRe, re, save);
+		savedIm = _mm256_blendv_pd(savedIm, im, save);
+		nextSave = _mm256_blendv_pd(nextSave, _mm256_add_pd(nextSave, nextSave), save);
+		if(done)
+		{
+			_mm256_storeu_pd(ua, u);
+			_mm256_storeu_pd(rea, re);
+			_mm256_storeu_pd(ima, im);
+			_mm256_storeu_pd(ita, it);
+			_mm256_storeu_pd(m2a, m2);
+			_mm256_storeu_pd(sra, savedRe);
+			_mm256_storeu_pd(sia, savedIm);
+			_mm256_storeu_pd(nsa, nextSave);
+			for(int l=0; l<4; l++)
+			{
+				if(!(done & (1<<l)))
+					continue;
+				nu[pixel[l]] = (esc & (1<<l)) ? smoothIteration((Uint32)ita[l]-1, m2a[l]) : NU_INSIDE;
+				if(cycle & (1<<l))
+					stats->periodic++;
+				next = nextPending(nu, next, n, first, stride, minX, v, spanfactor, stats);
+				if(next < n)
+				{
+					ua[l] = rea[l] = minX + (first + next*stride)*spanfactor;
+					ima[l] = v;
+					ita[l] = 0.0;
+					sra[l] = rea[l];
+					sia[l] = v;
+					nsa[l] = 1.0;
+					pixel[l] = next++;
+				}
+				else
+				{
+					active &= ~(1<<l);
+				}
+			}
+			u = _mm256_loadu_pd(ua);
+			re = _mm256_loadu_pd(rea);
+			im = _mm256_loadu_pd(ima);
+			it = _mm256_loadu_pd(ita);
+			savedRe = _mm256_loadu_pd(sra);
+			savedIm = _mm256_loadu_pd(sia);
+			nextSave = _mm256_loadu_pd(nsa);
+		}
+	}
+}
+
+TARGET_AVX2
+static void escapeRow_avx2_float(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m256 radius2 = _mm256_set1_ps((float)RADIUS2);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 eps = _mm256_set1_ps((float)(spanfactor*PERIOD_TOLERANCE));
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 vv = _mm256_set1_ps((float)v);
+	const __m256i lane = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	const __m256i laneBit = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+	float ua[8], escM2[8];
+	int escIt[8];
+
+	for(int x0=0; x0<n; x0+=8)
+	{
+		int skipped = 0;
+		for(int l=0; l<8; l++)
+		{
+			ua[l] = (float)(minX + (first + (x0+l)*stride)*spanfactor);
+			if(x0+l < n && insideMainComponents(minX + (first + (x0+l)*stride)*spanfactor, v)) //inside the main cardioid or the period-2 bulb
+				skipped |= 1<<l;
+		}
+		stats->skipped += __builtin_popcount(skipped);
+		__m256 u = _mm256_loadu_ps(ua);
+		__m256 re = u;
+		__m256 im = vv;
+		__m256 it = _mm256_setzero_ps(); //integer iteration counts, kept in a float register for blending
+		__m256 m2esc = _mm256_setzero_ps();
+		__m256 savedRe = re, savedIm = im;
+		__m256 periodic = _mm256_setzero_ps();
+		Uint32 nextSave = 1;
+		__m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_add_epi32(_mm256_set1_epi32(x0), lane))); //lanes past the end of the row never run
+		active = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(skipped), laneBit), laneBit)), active);
+
+		if(!_mm256_testz_ps(active, active)) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m256 tempRe = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)), u);
+				im = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(re, im), two), vv);
+				re = tempRe;
+				__m256 m2 = _mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im));
+				__m256 esc = _mm256_and_ps(_mm256_cmp_ps(m2, radius2, _CMP_GT_OQ), active);
+				if(!_mm256_testz_ps(esc, esc))
+				{
+					it = _mm256_blendv_ps(it, _mm256_castsi256_ps(_mm256_set1_epi32((int)i)), esc);
+					m2esc = _mm256_blendv_ps(m2esc, m2, esc);
+					active = _mm256_andnot_ps(esc, active);
+					if(_mm256_testz_ps(active, active))
+						break;
+				}
+				__m256 cycle = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(re, savedRe), absMask), eps, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(im, savedIm), absMask), eps, _CMP_LT_OQ)), active); //the orbit came back, it's periodic
+				if(!_mm256_testz_ps(cycle, cycle))
+				{
+					periodic = _mm256_or_ps(periodic, cycle);
+					active = _mm256_andnot_ps(cycle, active);
+					if(_mm256_testz_ps(active, active))
+						break;
+				}
+				if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+				{
+					savedRe = re;
+					savedIm = im;
+					nextSave <<= 1;
+				}
+			}
+		}
+
+		stats->periodic += __builtin_popcount(_mm256_movemask_ps(periodic));
+		int stillActive = _mm256_movemask_ps(_mm256_or_ps(active, periodic)) | skipped;
+		_mm256_storeu_si256((__m256i*)escIt, _mm256_castps_si256(it));
+		_mm256_storeu_ps(escM2, m2esc);
+		for(int l=0; l<8 && x0+l<n; l++)
+		{
+			nu[x0+l] = (stillActive & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+/* double-double operations on 4 lanes, hi and lo parts in separate registers (see zDoubleDouble.h) */
+
+TARGET_AVX2_FMA
+static inline void twoSum_avx2(__m256d a, __m256d b, __m256d* s, __m256d* e)
+{
+	*s = _mm256_add_pd(a, b);
+	__m256d bb = _mm256_sub_pd(*s, a);
+	*e = _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(*s, bb)), _mm256_sub_pd(b, bb));
+}
+
+TARGET_AVX2_FMA
+static inline void quickTwoSum_avx2(__m256d a, __m256d b, __m256d* s, __m256d* e)
+{
+	*s = _mm256_add_pd(a, b);
+	*e = _mm256_sub_pd(b, _mm256_sub_pd(*s, a));
+}
+
+TARGET_AVX2_FMA
+static inline void ddAdd_avx2(__m256d ah, __m256d al, __m256d bh, __m256d bl, __m256d* rh, __m256d* rl)
+{
+	__m256d sh, sl, th, tl;
+	twoSum_avx2(ah, bh, &sh, &sl);
+	twoSum_avx2(al, bl, &th, &tl);
+	quickTwoSum_avx2(sh, _mm256_add_pd(sl, th), &sh, &sl);
+	quickTwoSum_avx2(sh, _mm256_add_pd(sl, tl), rh, rl);
+}
+
+TARGET_AVX2_FMA
+static inline void ddMul_avx2(__m256d ah, __m256d al, __m256d bh, __m256d bl, __m256d* rh, __m256d* rl)
+{
+	__m256d p = _mm256_mul_pd(ah, bh);
+	__m256d e = _mm256_fmsub_pd(ah, bh, p);
+	quickTwoSum_avx2(p, _mm256_add_pd(e, _mm256_add_pd(_mm256_mul_pd(ah, bl), _mm256_mul_pd(al, bh))), rh, rl);
+}
+
+TARGET_AVX2_FMA
+static inline void ddSquare_avx2(__m256d ah, __m256d al, __m256d* rh, __m256d* rl)
+{
+	__m256d p = _mm256_mul_pd(ah, ah);
+	__m256d e = _mm256_fmsub_pd(ah, ah, p);
+	quickTwoSum_avx2(p, _mm256_add_pd(e, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), ah), al)), rh, rl);
+}
+
+TARGET_AVX2_FMA
+static void escapeRowDD_avx2(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m256d radius2 = _mm256_set1_pd(RADIUS2);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d eps = _mm256_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	const __m256d vh = _mm256_set1_pd(v.hi), vl = _mm256_set1_pd(v.lo);
+	double uh[4], ul[4], escIt[4], escM2[4];
+	Sint64 laneMask[4];
+
+	for(int x0=0; x0<n; x0+=4)
+	{
+		int skipped = 0;
+		for(int l=0; l<4; l++)
+		{
+			zDoubleDouble u = minX + (first + (x0+l)*stride)*spanfactor;
+			uh[l] = u.hi;
+			ul[l] = u.lo;
+			laneMask[l] = 0; //lanes past the end of the row never run
+			if(x0+l < n)
+			{
+				if(insideMainComponentsDD(u, v))
+					skipped |= 1<<l;
+				else
+					laneMask[l] = -1;
+			}
+		}
+		stats->skipped += __builtin_popcount(skipped);
+		__m256d active = _mm256_castsi256_pd(_mm256_loadu_si256((const __m256i*)laneMask));
+		__m256d uH = _mm256_loadu_pd(uh), uL = _mm256_loadu_pd(ul);
+		__m256d reH = uH, reL = uL;
+		__m256d imH = vh, imL = vl;
+		__m256d it = _mm256_setzero_pd();
+		__m256d m2esc = _mm256_setzero_pd();
+		__m256d savedReH = reH, savedReL = reL, savedImH = imH, savedImL = imL;
+		__m256d periodic = _mm256_setzero_pd();
+		Uint32 nextSave = 1;
+
+		if(!_mm256_testz_pd(active, active)) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m256d rrH, rrL, iiH, iiL, riH, riL, tH, tL;
+				ddSquare_avx2(reH, reL, &rrH, &rrL);
+				ddSquare_avx2(imH, imL, &iiH, &iiL);
+				ddMul_avx2(reH, reL, imH, imL, &riH, &riL);
+				ddAdd_avx2(rrH, rrL, _mm256_xor_pd(iiH, signMask), _mm256_xor_pd(iiL, signMask), &tH, &tL);
+				ddAdd_avx2(tH, tL, uH, uL, &reH, &reL);
+				ddAdd_avx2(_mm256_mul_pd(riH, two), _mm256_mul_pd(riL, two), vh, vl, &imH, &imL);
+				__m256d m2 = _mm256_add_pd(_mm256_mul_pd(reH, reH), _mm256_mul_pd(imH, imH));
+				__m256d esc = _mm256_and_pd(_mm256_cmp_pd(m2, radius2, _CMP_GT_OQ), active);
+				if(!_mm256_testz_pd(esc, esc))
+				{
+					it = _mm256_blendv_pd(it, _mm256_set1_pd((double)i), esc);
+					m2esc = _mm256_blendv_pd(m2esc, m2, esc);
+					active = _mm256_andnot_pd(esc, active);
+					if(_mm256_testz_pd(active, active))
+						break;
+				}
+				__m256d dRe = _mm256_add_pd(_mm256_sub_pd(reH, savedReH), _mm256_sub_pd(reL, savedReL));
+				__m256d dIm = _mm256_add_pd(_mm256_sub_pd(imH, savedImH), _mm256_sub_pd(imL, savedImL));
+				__m256d cycle = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(_mm256_and_pd(dRe, absMask), eps, _CMP_LT_OQ), _mm256_cmp_pd(_mm256_and_pd(dIm, absMask), eps, _CMP_LT_OQ)), active);
+				if(!_mm256_testz_pd(cycle, cycle))
+				{
+					periodic = _mm256_or_pd(periodic, cycle);
+					active = _mm256_andnot_pd(cycle, active);
+					if(_mm256_testz_pd(active, active))
+						break;
+				}
+				if(i+1 == nextSave)
+				{
+					savedReH = reH;
+					savedReL = reL;
+					savedImH = imH;
+					savedImL = imL;
+					nextSave <<= 1;
+				}
+			}
+		}
+
+		stats->periodic += __builtin_popcount(_mm256_movemask_pd(periodic));
+		int stillActive = _mm256_movemask_pd(_mm256_or_pd(active, periodic)) | skipped;
+		_mm256_storeu_pd(escIt, it);
+		_mm256_storeu_pd(escM2, m2esc);
+		for(int l=0; l<4 && x0+l<n; l++)
+		{
+			nu[x0+l] = (stillActive & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+TARGET_AVX2
+static Uint32 perturbLanes_avx2(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2)
+{
+	const __m256d radius2 = _mm256_set1_pd(RADIUS2);
+	double escIt[4], escM2[4];
+	Uint32 k;
+
+	__m256d dzr = _mm256_loadu_pd(lanes->dzr);
+	__m256d dzi = _mm256_loadu_pd(lanes->dzi);
+	const __m256d dcr = _mm256_loadu_pd(lanes->dcr);
+	const __m256d dci = _mm256_loadu_pd(lanes->dci);
+	__m256d active = _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_and_si256(_mm256_set1_epi64x(lanes->active), _mm256_set_epi64x(8, 4, 2, 1)), _mm256_setzero_si256()));
+	__m256d escaped = _mm256_setzero_pd(), glitched = _mm256_setzero_pd();
+	__m256d it = _mm256_setzero_pd(), m2esc = _mm256_setzero_pd();
+
+	for(k=0; k<count; k++)
+	{
+		/* one load of the reference for every lane */
+		__m256d ar = _mm256_add_pd(_mm256_set1_pd(2.0*Zr[k]), dzr);
+		__m256d ai = _mm256_add_pd(_mm256_set1_pd(2.0*Zi[k]), dzi);
+		__m256d tempRe = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(ar, dzr), _mm256_mul_pd(ai, dzi)), dcr);
+		dzi = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ar, dzi), _mm256_mul_pd(ai, dzr)), dci);
+		dzr = tempRe;
+		__m256d zr = _mm256_add_pd(_mm256_set1_pd(Zr[k+1]), dzr);
+		__m256d zi = _mm256_add_pd(_mm256_set1_pd(Zi[k+1]), dzi);
+		__m256d m2 = _mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+		__m256d esc = _mm256_and_pd(_mm256_cmp_pd(m2, radius2, _CMP_GT_OQ), active);
+		__m256d glitch = _mm256_andnot_pd(esc, _mm256_and_pd(_mm256_cmp_pd(m2, _mm256_set1_pd(tolerance2*(Zr[k+1]*Zr[k+1] + Zi[k+1]*Zi[k+1])), _CMP_LT_OQ), active));
+		__m256d stop = _mm256_or_pd(esc, glitch);
+		if(!_mm256_testz_pd(stop, stop))
+		{
+			it = _mm256_blendv_pd(it, _mm256_set1_pd((double)(i+k)), esc);
+			m2esc = _mm256_blendv_pd(m2esc, m2, esc);
+			escaped = _mm256_or_pd(escaped, esc);
+			glitched = _mm256_or_pd(glitched, glitch);
+			active = _mm256_andnot_pd(stop, active);
+			if(_mm256_testz_pd(active, active))
+			{
+				k++;
+				break;
+			}
+		}
+	}
+
+	_mm256_storeu_pd(lanes->dzr, dzr);
+	_mm256_storeu_pd(lanes->dzi, dzi);
+	_mm256_storeu_pd(escIt, it);
+	_mm256_storeu_pd(escM2, m2esc);
+	int escMask = _mm256_movemask_pd(escaped), glitchMask = _mm256_movemask_pd(glitched);
+	for(int l=0; l<4; l++)
+	{
+		if(escMask & (1<<l))
+			lanes->nu[l] = smoothIteration((Uint32)escIt[l], escM2[l]);
+		if(glitchMask & (1<<l))
+			lanes->glitched[l] = 1;
+	}
+	lanes->active = _mm256_movemask_pd(active);
+	return k;
+}
+
+TARGET_AVX2
+static void colorRow_avx2(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i alpha = _mm_set1_epi32((0xFF >> format->Aloss << format->Ashift) & format->Amask);
+	const __m128i insidePoint = _mm_set1_epi32(SDL_MapRGBA(format, inside.r, inside.g, inside.b, 0xFF));
+	const __m128i rshift = _mm_cvtsi32_si128(format->Rshift);
+	const __m128i gshift = _mm_cvtsi32_si128(format->Gshift);
+	const __m128i bshift = _mm_cvtsi32_si128(format->Bshift);
+	int x;
+
+	for(x=0; x+4<=n; x+=4)
+	{
+		__m256d nu4 = _mm256_loadu_pd(nu+x);
+		__m256d t = _mm256_sub_pd(nu4, _mm256_floor_pd(nu4));
+		__m256d omt = _mm256_sub_pd(one, t);
+		__m256d interpolated = _mm256_and_pd(_mm256_cmp_pd(t, zero, _CMP_GE_OQ), _mm256_cmp_pd(t, one, _CMP_LE_OQ)); //0<=t<=1, as in linear_interpolation()
+		__m128i interpolated4 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(interpolated), _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+		__m128i index = _mm256_cvttpd_epi32(nu4);
+		__m128i c1 = _mm_i32gather_epi32((const int*)palette, _mm_and_si128(index, mask), 4);
+		__m128i c2 = _mm_i32gather_epi32((const int*)palette, _mm_and_si128(_mm_add_epi32(index, _mm_set1_epi32(1)), mask), 4);
+
+		/* SDL_Color is {r, g, b, a} in memory */
+		__m128i r = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(omt, _mm256_cvtepi32_pd(_mm_and_si128(c1, mask))), _mm256_mul_pd(t, _mm256_cvtepi32_pd(_mm_and_si128(c2, mask)))));
+		__m128i g = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(omt, _mm256_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c1, 8), mask))), _mm256_mul_pd(t, _mm256_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c2, 8), mask)))));
+		__m128i b = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(omt, _mm256_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c1, 16), mask))), _mm256_mul_pd(t, _mm256_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c2, 16), mask)))));
+		__m128i point = _mm_or_si128(_mm_or_si128(_mm_sll_epi32(r, rshift), _mm_sll_epi32(g, gshift)), _mm_or_si128(_mm_sll_epi32(b, bshift), alpha));
+		point = _mm_blendv_epi8(insidePoint, point, interpolated4);
+		_mm_storeu_si128((__m128i*)(pixels+x), point);
+	}
+	colorRow_scalar(pixels+x, nu+x, n-x, palette, inside, format);
+}
+
+TARGET_AVX2
+static inline __m256i average_pixels_avx2(__m256i a, __m256i b)
+{
+	return _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1)));
+}
+
+TARGET_AVX2
+static void gaussian_blur_avx2(Uint32* pixels, int w, int h, int stride)
+{
+	int i;
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(i=1; i+8<=w-1; i+=8)
+			_mm256_storeu_si256((__m256i*)(row+i), average_pixels_avx2(_mm256_loadu_si256((__m256i*)(row+i)), _mm256_loadu_si256((__m256i*)(row+i+1))));
+		for(; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+1]);
+	}
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(i=1; i+8<=w-1; i+=8)
+			_mm256_storeu_si256((__m256i*)(row+i), average_pixels_avx2(_mm256_loadu_si256((__m256i*)(row+i)), _mm256_loadu_si256((__m256i*)(row+i+stride))));
+		for(; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+stride]);
+	}
+}
+
+
+
+
+/* AVX-512 kernels */
+
+TARGET_AVX512
+static void escapeRow_avx512(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m512d radius2 = _mm512_set1_pd(RADIUS2);
+	const __m512d two = _mm512_set1_pd(2.0);
+	const __m512d eps = _mm512_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m512d vv = _mm512_set1_pd(v);
+	const __m512d lane = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	const __m512d sixteenth = _mm512_set1_pd(0.0625);
+	const __m512d y2 = _mm512_set1_pd(v*v);
+	const __m512d qy2 = _mm512_set1_pd(0.25*v*v);
+	double escIt[8], escM2[8];
+
+	for(int x0=0; x0<n; x0+=8)
+	{
+		__m512d xx = _mm512_add_pd(_mm512_set1_pd((double)x0), lane);
+		__m512d px = _mm512_add_pd(_mm512_set1_pd((double)first), _mm512_mul_pd(xx, _mm512_set1_pd((double)stride))); //exact, as in escapeRow_scalar
+		__m512d u = _mm512_add_pd(_mm512_set1_pd(minX), _mm512_mul_pd(px, _mm512_set1_pd(spanfactor)));
+		__m512d re = u;
+		__m512d im = vv;
+		__m512d it = _mm512_setzero_pd();
+		__m512d m2esc = _mm512_setzero_pd();
+		__m512d savedRe = re, savedIm = im;
+		__mmask8 periodic = 0;
+		Uint32 nextSave = 1;
+		__mmask8 active = (n-x0 >= 8) ? 0xFF : (__mmask8)((1<<(n-x0))-1); //lanes past the end of the row never run
+		__mmask8 valid = active;
+
+		__m512d xq = _mm512_sub_pd(u, quarter);
+		__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), y2);
+		__m512d xb = _mm512_add_pd(u, one);
+		__mmask8 skipped = _mm512_mask_cmp_pd_mask(active, _mm512_mul_pd(q, _mm512_add_pd(q, xq)), qy2, _CMP_LE_OQ) | _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(xb, xb), y2), sixteenth, _CMP_LE_OQ); //inside the main cardioid or the period-2 bulb
+		active &= ~skipped;
+		stats->skipped += __builtin_popcount(skipped);
+
+		if(active) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m512d tempRe = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im)), u);
+				im = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(re, im), two), vv);
+				re = tempRe;
+				__m512d m2 = _mm512_add_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im));
+				__mmask8 esc = _mm512_mask_cmp_pd_mask(active, m2, radius2, _CMP_GT_OQ);
+				if(esc)
+				{
+					it = _mm512_mask_mov_pd(it, esc, _mm512_set1_pd((double)i));
+					m2esc = _mm512_mask_mov_pd(m2esc, esc, m2);
+					active &= ~esc;
+					if(!active)
+						break;
+				}
+				__mmask8 cycle = _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(_mm512_sub_pd(re, savedRe)), eps, _CMP_LT_OQ) & _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(_mm512_sub_pd(im, savedIm)), eps, _CMP_LT_OQ); //the orbit came back, it's periodic
+				if(cycle)
+				{
+					periodic |= cycle;
+					active &= ~cycle;
+					if(!active)
+						break;
+				}
+				if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+				{
+					savedRe = re;
+					savedIm = im;
+					nextSave <<= 1;
+				}
+			}
+		}
+		stats->periodic += __builtin_popcount(periodic);
+
+		_mm512_storeu_pd(escIt, it);
+		_mm512_storeu_pd(escM2, m2esc);
+		for(int l=0; l<8; l++)
+		{
+			if(valid & (1<<l))
+				nu[x0+l] = ((active | skipped | periodic) & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+TARGET_AVX512
+static void escapeRow_avx512_refill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m512d radius2 = _mm512_set1_pd(RADIUS2);
+	const __m512d two = _mm512_set1_pd(2.0);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d vv = _mm512_set1_pd(v);
+	const __m512d maxItv = _mm512_set1_pd((double)maxIt);
+	const __m512d eps = _mm512_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	double ua[8], rea[8], ima[8], ita[8], m2a[8], sra[8], sia[8], nsa[8];
+	int pixel[8];
+	__mmask8 active = 0;
+	int next = 0;
+
+	if(maxIt == 0)
+	{
+		escapeRow_scalar(nu, n, first, stride, minX, v, spanfactor, maxIt, stats); //nothing to refill
+		return;
+	}
+
+	for(int l=0; l<8; l++)
+	{
+		next = nextPending(nu, next, n, first, stride, minX, v, spanfactor, stats);
+		ua[l] = rea[l] = minX + (first + next*stride)*spanfactor;
+		ima[l] = v;
+		ita[l] = 0.0;
+		sra[l] = rea[l];
+		sia[l] = v;
+		nsa[l] = 1.0;
+		pixel[l] = next;
+		if(next < n)
+		{
+			active |= 1<<l;
+			next++;
+		}
+	}
+	__m512d u = _mm512_loadu_pd(ua), re = _mm512_loadu_pd(rea), im = _mm512_loadu_pd(ima), it = _mm512_loadu_pd(ita);
+	__m512d savedRe = _mm512_loadu_pd(sra), savedIm = _mm512_loadu_pd(sia), nextSave = _mm512_loadu_pd(nsa);
+
+	while(active)
+	{
+		__m512d tempRe = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im)), u);
+		im = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(re, im), two), vv);
+		re = tempRe;
+		__m512d m2 = _mm512_add_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im));
+		it = _mm512_add_pd(it, one);
+		__mmask8 esc = _mm512_mask_cmp_pd_mask(active, m2, radius2, _CMP_GT_OQ);
+		__mmask8 cycle = _mm512_mask_cmp_pd_mask(active & ~esc, _mm512_abs_pd(_mm512_sub_pd(re, savedRe)), eps, _CMP_LT_OQ) & _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(im, savedIm)), eps, _CMP_LT_OQ); //the orbit came back, it's periodic
+		__mmask8 done = esc | cycle | _mm512_mask_cmp_pd_mask(active, it, maxItv, _CMP_GE_OQ);
+		__mmask8 save = _mm512_cmp_pd_mask(it, nextSave, _CMP_EQ_OQ); //Brent: each lane's saved point moves forward at every power of two
+		savedRe = _mm512_mask_mov_pd(savedRe, save, re);
+		savedIm = _mm512_mask_mov_pd(savedIm, save, im);
+		nextSave = _mm512_mask_mov_pd(nextSave, save, _mm512_add_pd(nextSave, nextSave));
+		if(done)
+		{
+			_mm512_storeu_pd(ua, u);
+			_mm512_storeu_pd(rea, re);
+			_mm512_storeu_pd(ima, im);
+			_mm512_storeu_pd(ita, it);
+			_mm512_storeu_pd(m2a, m2);
+			_mm512_storeu_pd(sra, savedRe);
+			_mm512_storeu_pd(sia, savedIm);
+			_mm512_storeu_pd(nsa, nextSave);
+			for(int l=0; l<8; l++)
+			{
+				if(!(done & (1<<l)))
+					continue;
+				nu[pixel[l]] = (esc & (1<<l)) ? smoothIteration((Uint32)ita[l]-1, m2a[l]) : NU_INSIDE;
+				if(cycle & (1<<l))
+					stats->periodic++;
+				next = nextPending(nu, next, n, first, stride, minX, v, spanfactor, stats);
+				if(next < n)
+				{
+					ua[l] = rea[l] = minX + (first + next*stride)*spanfactor;
+					ima[l] = v;
+					ita[l] = 0.0;
+					sra[l] = rea[l];
+					sia[l] = v;
+					nsa[l] = 1.0;
+					pixel[l] = next++;
+				}
+				else
+				{
+					active &= ~(1<<l);
+				}
+			}
+			u = _mm512_loadu_pd(ua);
+			re = _mm512_loadu_pd(rea);
+			im = _mm512_loadu_pd(ima);
+			it = _mm512_loadu_pd(ita);
+			savedRe = _mm512_loadu_pd(sra);
+			savedIm = _mm512_loadu_pd(sia);
+			nextSave = _mm512_loadu_pd(nsa);
+		}
+	}
+}
+
+TARGET_AVX512
+static void escapeRow_avx512_float(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m512 radius2 = _mm512_set1_ps((float)RADIUS2);
+	const __m512 two = _mm512_set1_ps(2.0f);
+	const __m512 eps = _mm512_set1_ps((float)(spanfactor*PERIOD_TOLERANCE));
+	const __m512 vv = _mm512_set1_ps((float)v);
+	float ua[16], escM2[16];
+	int escIt[16];
+
+	for(int x0=0; x0<n; x0+=16)
+	{
+		int skipped = 0;
+		for(int l=0; l<16; l++)
+		{
+			ua[l] = (float)(minX + (first + (x0+l)*stride)*spanfactor);
+			if(x0+l < n && insideMainComponents(minX + (first + (x0+l)*stride)*spanfactor, v)) //inside the main cardioid or the period-2 bulb
+				skipped |= 1<<l;
+		}
+		stats->skipped += __builtin_popcount(skipped);
+		__m512 u = _mm512_loadu_ps(ua);
+		__m512 re = u;
+		__m512 im = vv;
+		__m512i it = _mm512_setzero_si512();
+		__m512 m2esc = _mm512_setzero_ps();
+		__m512 savedRe = re, savedIm = im;
+		__mmask16 periodic = 0;
+		Uint32 nextSave = 1;
+		__mmask16 active = (n-x0 >= 16) ? 0xFFFF : (__mmask16)((1<<(n-x0))-1); //lanes past the end of the row never run
+		__mmask16 valid = active;
+		active &= ~skipped;
+
+		if(active) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m512 tempRe = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im)), u);
+				im = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(re, im), two), vv);
+				re = tempRe;
+				__m512 m2 = _mm512_add_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im));
+				__mmask16 esc = _mm512_mask_cmp_ps_mask(active, m2, radius2, _CMP_GT_OQ);
+				if(esc)
+				{
+					it = _mm512_mask_mov_epi32(it, esc, _mm512_set1_epi32((int)i));
+					m2esc = _mm512_mask_mov_ps(m2esc, esc, m2);
+					active &= ~esc;
+					if(!active)
+						break;
+				}
+				__mmask16 cycle = _mm512_mask_cmp_ps_mask(active, _mm512_abs_ps(_mm512_sub_ps(re, savedRe)), eps, _CMP_LT_OQ) & _mm512_mask_cmp_ps_mask(active, _mm512_abs_ps(_mm512_sub_ps(im, savedIm)), eps, _CMP_LT_OQ); //the orbit came back, it's periodic
+				if(cycle)
+				{
+					periodic |= cycle;
+					active &= ~cycle;
+					if(!active)
+						break;
+				}
+				if(i+1 == nextSave) //Brent: the saved point moves forward at every power of two
+				{
+					savedRe = re;
+					savedIm = im;
+					nextSave <<= 1;
+				}
+			}
+		}
+		stats->periodic += __builtin_popcount(periodic);
+
+		_mm512_storeu_si512((void*)escIt, it);
+		_mm512_storeu_ps(escM2, m2esc);
+		for(int l=0; l<16; l++)
+		{
+			if(valid & (1<<l))
+				nu[x0+l] = ((active | skipped | periodic) & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+/* double-double operations on 8 lanes, hi and lo parts in separate registers (see zDoubleDouble.h) */
+
+TARGET_AVX512
+static inline void twoSum_avx512(__m512d a, __m512d b, __m512d* s, __m512d* e)
+{
+	*s = _mm512_add_pd(a, b);
+	__m512d bb = _mm512_sub_pd(*s, a);
+	*e = _mm512_add_pd(_mm512_sub_pd(a, _mm512_sub_pd(*s, bb)), _mm512_sub_pd(b, bb));
+}
+
+TARGET_AVX512
+static inline void quickTwoSum_avx512(__m512d a, __m512d b, __m512d* s, __m512d* e)
+{
+	*s = _mm512_add_pd(a, b);
+	*e = _mm512_sub_pd(b, _mm512_sub_pd(*s, a));
+}
+
+TARGET_AVX512
+static inline void ddAdd_avx512(__m512d ah, __m512d al, __m512d bh, __m512d bl, __m512d* rh, __m512d* rl)
+{
+	__m512d sh, sl, th, tl;
+	twoSum_avx512(ah, bh, &sh, &sl);
+	twoSum_avx512(al, bl, &th, &tl);
+	quickTwoSum_avx512(sh, _mm512_add_pd(sl, th), &sh, &sl);
+	quickTwoSum_avx512(sh, _mm512_add_pd(sl, tl), rh, rl);
+}
+
+TARGET_AVX512
+static inline void ddMul_avx512(__m512d ah, __m512d al, __m512d bh, __m512d bl, __m512d* rh, __m512d* rl)
+{
+	__m512d p = _mm512_mul_pd(ah, bh);
+	__m512d e = _mm512_fmsub_pd(ah, bh, p);
+	quickTwoSum_avx512(p, _mm512_add_pd(e, _mm512_add_pd(_mm512_mul_pd(ah, bl), _mm512_mul_pd(al, bh))), rh, rl);
+}
+
+TARGET_AVX512
+static inline void ddSquare_avx512(__m512d ah, __m512d al, __m512d* rh, __m512d* rl)
+{
+	__m512d p = _mm512_mul_pd(ah, ah);
+	__m512d e = _mm512_fmsub_pd(ah, ah, p);
+	quickTwoSum_avx512(p, _mm512_add_pd(e, _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(2.0), ah), al)), rh, rl);
+}
+
+TARGET_AVX512
+static void escapeRowDD_avx512(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats)
+{
+	const __m512d radius2 = _mm512_set1_pd(RADIUS2);
+	const __m512d two = _mm512_set1_pd(2.0);
+	const __m512d eps = _mm512_set1_pd(spanfactor*PERIOD_TOLERANCE);
+	const __m512i signMask = _mm512_set1_epi64(0x8000000000000000LL);
+	const __m512d vh = _mm512_set1_pd(v.hi), vl = _mm512_set1_pd(v.lo);
+	double uh[8], ul[8], escIt[8], escM2[8];
+
+	for(int x0=0; x0<n; x0+=8)
+	{
+		__mmask8 skipped = 0, active = 0;
+		for(int l=0; l<8; l++)
+		{
+			zDoubleDouble u = minX + (first + (x0+l)*stride)*spanfactor;
+			uh[l] = u.hi;
+			ul[l] = u.lo;
+			if(x0+l < n) //lanes past the end of the row never run
+			{
+				if(insideMainComponentsDD(u, v))
+					skipped |= 1<<l;
+				else
+					active |= 1<<l;
+			}
+		}
+		stats->skipped += __builtin_popcount(skipped);
+		__m512d uH = _mm512_loadu_pd(uh), uL = _mm512_loadu_pd(ul);
+		__m512d reH = uH, reL = uL;
+		__m512d imH = vh, imL = vl;
+		__m512d it = _mm512_setzero_pd();
+		__m512d m2esc = _mm512_setzero_pd();
+		__m512d savedReH = reH, savedReL = reL, savedImH = imH, savedImL = imL;
+		__mmask8 periodic = 0;
+		Uint32 nextSave = 1;
+
+		if(active) //else the whole group is inside
+		{
+			for(Uint32 i=0; i<maxIt; i++)
+			{
+				__m512d rrH, rrL, iiH, iiL, riH, riL, tH, tL;
+				ddSquare_avx512(reH, reL, &rrH, &rrL);
+				ddSquare_avx512(imH, imL, &iiH, &iiL);
+				ddMul_avx512(reH, reL, imH, imL, &riH, &riL);
+				ddAdd_avx512(rrH, rrL, _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(iiH), signMask)), _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(iiL), signMask)), &tH, &tL);
+				ddAdd_avx512(tH, tL, uH, uL, &reH, &reL);
+				ddAdd_avx512(_mm512_mul_pd(riH, two), _mm512_mul_pd(riL, two), vh, vl, &imH, &imL);
+				__m512d m2 = _mm512_add_pd(_mm512_mul_pd(reH, reH), _mm512_mul_pd(imH, imH));
+				__mmask8 esc = _mm512_mask_cmp_pd_mask(active, m2, radius2, _CMP_GT_OQ);
+				if(esc)
+				{
+					it = _mm512_mask_mov_pd(it, esc, _mm512_set1_pd((double)i));
+					m2esc = _mm512_mask_mov_pd(m2esc, esc, m2);
+					active &= ~esc;
+					if(!active)
+						break;
+				}
+				__m512d dRe = _mm512_add_pd(_mm512_sub_pd(reH, savedReH), _mm512_sub_pd(reL, savedReL));
+				__m512d dIm = _mm512_add_pd(_mm512_sub_pd(imH, savedImH), _mm512_sub_pd(imL, savedImL));
+				__mmask8 cycle = _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(dRe), eps, _CMP_LT_OQ) & _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(dIm), eps, _CMP_LT_OQ);
+				if(cycle)
+				{
+					periodic |= cycle;
+					active &= ~cycle;
+					if(!active)
+						break;
+				}
+				if(i+1 == nextSave)
+				{
+					savedReH = reH;
+					savedReL = reL;
+					savedImH = imH;
+					savedImL = imL;
+					nextSave <<= 1;
+				}
+			}
+		}
+		stats->periodic += __builtin_popcount(periodic);
+
+		_mm512_storeu_pd(escIt, it);
+		_mm512_storeu_pd(escM2, m2esc);
+		for(int l=0; l<8 && x0+l<n; l++)
+		{
+			nu[x0+l] = ((active | skipped | periodic) & (1<<l)) ? NU_INSIDE : smoothIteration((Uint32)escIt[l], escM2[l]);
+		}
+	}
+}
+
+TARGET_AVX512
+static Uint32 perturbLanes_avx512(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2)
+{
+	const __m512d radius2 = _mm512_set1_pd(RADIUS2);
+	double escIt[8], escM2[8];
+	Uint32 k;
+
+	__m512d dzr = _mm512_loadu_pd(lanes->dzr);
+	__m512d dzi = _mm512_loadu_pd(lanes->dzi);
+	const __m512d dcr = _mm512_loadu_pd(lanes->dcr);
+	const __m512d dci = _mm512_loadu_pd(lanes->dci);
+	__mmask8 active = (__mmask8)lanes->active, escaped = 0, glitched = 0;
+	__m512d it = _mm512_setzero_pd(), m2esc = _mm512_setzero_pd();
+
+	for(k=0; k<count; k++)
+	{
+		/* one load of the reference for every lane */
+		__m512d ar = _mm512_add_pd(_mm512_set1_pd(2.0*Zr[k]), dzr);
+		__m512d ai = _mm512_add_pd(_mm512_set1_pd(2.0*Zi[k]), dzi);
+		__m512d tempRe = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(ar, dzr), _mm512_mul_pd(ai, dzi)), dcr);
+		dzi = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(ar, dzi), _mm512_mul_pd(ai, dzr)), dci);
+		dzr = tempRe;
+		__m512d zr = _mm512_add_pd(_mm512_set1_pd(Zr[k+1]), dzr);
+		__m512d zi = _mm512_add_pd(_mm512_set1_pd(Zi[k+1]), dzi);
+		__m512d m2 = _mm512_add_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi));
+		__mmask8 esc = _mm512_mask_cmp_pd_mask(active, m2, radius2, _CMP_GT_OQ);
+		__mmask8 glitch = _mm512_mask_cmp_pd_mask(active & ~esc, m2, _mm512_set1_pd(tolerance2*(Zr[k+1]*Zr[k+1] + Zi[k+1]*Zi[k+1])), _CMP_LT_OQ);
+		if(esc | glitch)
+		{
+			it = _mm512_mask_mov_pd(it, esc, _mm512_set1_pd((double)(i+k)));
+			m2esc = _mm512_mask_mov_pd(m2esc, esc, m2);
+			escaped |= esc;
+			glitched |= glitch;
+			active &= ~(esc | glitch);
+			if(!active)
+			{
+				k++;
+				break;
+			}
+		}
+	}
+
+	_mm512_storeu_pd(lanes->dzr, dzr);
+	_mm512_storeu_pd(lanes->dzi, dzi);
+	_mm512_storeu_pd(escIt, it);
+	_mm512_storeu_pd(escM2, m2esc);
+	for(int l=0; l<8; l++)
+	{
+		if(escaped & (1<<l))
+			lanes->nu[l] = smoothIteration((Uint32)escIt[l], escM2[l]);
+		if(glitched & (1<<l))
+			lanes->glitched[l] = 1;
+	}
+	lanes->active = active;
+	return k;
+}
+
+TARGET_AVX512
+static void colorRow_avx512(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format)
+{
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256i alpha = _mm256_set1_epi32((0xFF >> format->Aloss << format->Ashift) & format->Amask);
+	const __m256i insidePoint = _mm256_set1_epi32(SDL_MapRGBA(format, inside.r, inside.g, inside.b, 0xFF));
+	const __m128i rshift = _mm_cvtsi32_si128(format->Rshift);
+	const __m128i gshift = _mm_cvtsi32_si128(format->Gshift);
+	const __m128i bshift = _mm_cvtsi32_si128(format->Bshift);
+	int x;
+
+	for(x=0; x+8<=n; x+=8)
+	{
+		__m512d nu8 = _mm512_loadu_pd(nu+x);
+		__m512d t = _mm512_sub_pd(nu8, _mm512_floor_pd(nu8));
+		__m512d omt = _mm512_sub_pd(one, t);
+		__mmask8 interpolated = _mm512_cmp_pd_mask(t, zero, _CMP_GE_OQ) & _mm512_cmp_pd_mask(t, one, _CMP_LE_OQ); //0<=t<=1, as in linear_interpolation()
+		__m256i index = _mm512_maskz_cvttpd_epi32(0xFF, nu8);
+		__m256i c1 = _mm256_i32gather_epi32((const int*)palette, _mm256_and_si256(index, mask), 4);
+		__m256i c2 = _mm256_i32gather_epi32((const int*)palette, _mm256_and_si256(_mm256_add_epi32(index, _mm256_set1_epi32(1)), mask), 4);
+
+		/* SDL_Color is {r, g, b, a} in memory */
+		__m256i r = _mm512_maskz_cvttpd_epi32(0xFF, _mm512_add_pd(_mm512_mul_pd(omt, _mm512_maskz_cvtepi32_pd(0xFF, _mm256_and_si256(c1, mask))), _mm512_mul_pd(t, _mm512_maskz_cvtepi32_pd(0xFF, _mm256_and_si256(c2, mask)))));
+		__m256i g = _mm512_maskz_cvttpd_epi32(0xFF, _mm512_add_pd(_mm512_mul_pd(omt, _mm512_maskz_cvtepi32_pd(0xFF, _mm256_and_si256(_mm256_srli_epi32(c1, 8), mask))), _mm512_mul_pd(t, _mm512_maskz_cvtepi32_pd(0xFF, _mm256_and_si256(_mm256_srli_epi32(c2, 8), mask)))));
+		__m256i b = _mm512_maskz_cvttpd_epi32(0xFF, _mm512_add_pd(_mm512_mul_pd(omt, _mm512_maskz_cvtepi32_pd(0xFF, _mm256_and_si256(_mm256_srli_epi32(c1, 16), mask))), _mm512_mul_pd(t, _mm512_maskz_cvtepi32_pd(0xFF, _mm256_and_si256(_mm256_srli_epi32(c2, 16), mask)))));
+		__m256i point = _mm256_or_si256(_mm256_or_si256(_mm256_sll_epi32(r, rshift), _mm256_sll_epi32(g, gshift)), _mm256_or_si256(_mm256_sll_epi32(b, bshift), alpha));
+		point = _mm256_mask_mov_epi32(insidePoint, interpolated, point);
+		_mm256_storeu_si256((__m256i*)(pixels+x), point);
+	}
+	colorRow_scalar(pixels+x, nu+x, n-x, palette, inside, format);
+}
+
+TARGET_AVX512
+static inline __m512i average_pixels_avx512(__m512i a, __m512i b)
+{
+	return _mm512_sub_epi8(_mm512_avg_epu8(a, b), _mm512_and_si512(_mm512_xor_si512(a, b), _mm512_set1_epi8(1)));
+}
+
+TARGET_AVX512
+static void gaussian_blur_avx512(Uint32* pixels, int w, int h, int stride)
+{
+	int i;
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(i=1; i+16<=w-1; i+=16)
+			_mm512_storeu_si512((void*)(row+i), average_pixels_avx512(_mm512_loadu_si512((void*)(row+i)), _mm512_loadu_si512((void*)(row+i+1))));
+		for(; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+1]);
+	}
+	for(int j=1; j<h-1; j++)
+	{
+		Uint32* row = pixels + j*stride;
+		for(i=1; i+16<=w-1; i+=16)
+			_mm512_storeu_si512((void*)(row+i), average_pixels_avx512(_mm512_loadu_si512((void*)(row+i)), _mm512_loadu_si512((void*)(row+i+stride))));
+		for(; i<w-1; i++)
+			row[i] = average_pixel(row[i], row[i+stride]);
+	}
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+zKernel, escape-time kernels for zMand.
+Copyright (C) 2014  Davide Zagami
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZKERNEL_H
+#define ZKERNEL_H
+
+#include "zDoubleDouble.h"
+#include <SDL.h>
+#include <cmath>
+
+const double RADIUS2 = 4.0;
+const double log2_0 = log(2.0);
+const int PALETTE_SIZE = 256;
+
+//Pixel spacing, relative to the largest coordinate in view, below which single precision isn't trusted (256 float ulps)
+const double FLOAT_MIN_SPACING = 1.0/65536.0;
+
+//Same, for double-double precision (256 double-double ulps)
+const double DOUBLEDOUBLE_MIN_SPACING = 1.0/79228162514264337593543950336.0;
+
+//Smooth iteration count of pixels that never escaped
+const double NU_INSIDE = -HUGE_VAL;
+
+//An orbit coming back closer than this many pixel spacings to a point it went through is taken as periodic
+const double PERIOD_TOLERANCE = 1.0/1024.0;
+
+//Instruction set levels the kernels are built for
+enum
+{
+	ISA_GENERIC = 0,
+	ISA_SSE2,
+	ISA_AVX2,
+	ISA_AVX512,
+	NUM_ISA
+};
+
+
+//Work counters the kernels add to
+struct zKernelStats
+{
+	Uint32 skipped; //pixels found inside the main cardioid or the period-2 bulb without iterating
+	Uint32 periodic; //pixels whose orbit was found to be periodic before maxIt
+	Uint64 approximated; //iterations skipped by approximating many at once (deep zooms)
+};
+
+
+
+//Best instruction set level supported by both the processor and the operating system
+int detectIsa();
+
+//Selects the kernels built for the given level (or the detected one, if lower), returns the selected level
+int selectIsa(int isa);
+
+//Currently selected level
+int getIsa();
+
+//Level names, as accepted on the command line
+const char* isaName(int isa);
+int isaFromName(const char* name); //-1 if unknown
+
+//Smooth iteration count of a pixel that escaped at iteration i with |z|^2 = modulus2
+double smoothIteration(Uint32 i, double modulus2);
+
+//Iterates n pixels of a row, stride pixels apart from pixel first: the x-th being c = (minX + (first + x*stride)*spanfactor) + v*i.
+//Writes to nu the smooth iteration count of every pixel, or NU_INSIDE if it didn't escape within maxIt iterations.
+//Pixels inside the main cardioid or the period-2 bulb are marked NU_INSIDE without iterating.
+//Orbits are checked for cycles (Brent's method, within PERIOD_TOLERANCE pixels of spanfactor): periodic pixels stop early, as NU_INSIDE.
+void escapeRow(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+
+//Same as escapeRow, refilling vector lanes with the next pixel of the row as soon as theirs is done, instead of waiting for the whole group
+void escapeRowRefill(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+
+//Whether pixels spanfactor apart anywhere in [x0, x1]x[y0, y1] can be iterated in single precision
+bool singlePrecisionSuffices(double x0, double y0, double x1, double y1, double spanfactor);
+
+//Same as escapeRow, in single precision (twice the lanes)
+void escapeRowFloat(double* nu, int n, int first, int stride, double minX, double v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+
+//Whether pixels spanfactor apart anywhere in [x0, x1]x[y0, y1] can be iterated in double-double precision
+bool doubleDoublePrecisionSuffices(double x0, double y0, double x1, double y1, double spanfactor);
+
+//Same as escapeRow, in double-double precision, for views past double precision.
+//Offsets from minX and v only need to be accurate relative to the view, so spanfactor is a double.
+void escapeRowDD(double* nu, int n, int first, int stride, const zDoubleDouble& minX, const zDoubleDouble& v, double spanfactor, Uint32 maxIt, zKernelStats* stats);
+
+//Lanes of the perturbation kernels, at most
+const int PERTURB_LANES = 8;
+
+//Pixels iterated together by perturbLanes(), as differences dz of their z_i+1 from the same reference iteration Z_m
+struct zPerturbLanes
+{
+	double dzr[PERTURB_LANES], dzi[PERTURB_LANES];
+	double dcr[PERTURB_LANES], dci[PERTURB_LANES]; //c - C
+	double nu[PERTURB_LANES]; //smooth iteration count, set when a lane escapes
+	Uint8 glitched[PERTURB_LANES]; //set when a lane glitches
+	int active; //bit l is set while lane l iterates
+};
+
+//Lanes perturbLanes() iterates at once with the selected kernels
+int perturbLaneCount();
+
+//Iterates the active lanes from iteration i along the reference iterations Z_m..Z_m+count in Zr and Zi (Z_m first),
+//dz_m+1 = (2*Z_m + dz_m)*dz_m + dc, with the same operations as perturbRow() and the loads of Z shared by every lane.
+//Lanes that escape stop with their nu set, lanes that come closer to 0 than tolerance2*|Z|^2 (never, if it's 0) stop
+//with glitched set. Returns the iterations done, fewer than count only once no lane is active.
+Uint32 perturbLanes(zPerturbLanes* lanes, const double* Zr, const double* Zi, Uint32 count, Uint32 i, double tolerance2);
+
+//Colors n pixels from their smooth iteration counts, interpolating between consecutive palette entries
+void colorRow(Uint32* pixels, const double* nu, int n, const SDL_Color* palette, SDL_Color inside, const SDL_PixelFormat* format);
+
+//Blurs a 32 bit surface in place
+void gaussian_blur(SDL_Surface* surface);
+
+#endif
@@ -650,3 +650,194 @@ bool zLabel::refresh(SDL_Renderer* renderer)
 
 
 
+
+zThreadPool::zThreadPool()
+{
+	mSize = 0;
+	mLock = NULL;
+	mWork = NULL;
+	mDone = NULL;
+	mJob = NULL;
+	mData = NULL;
+	mCount = 0;
+	mNext = 0;
+	mPending = 0;
+}
+
+zThreadPool::~zThreadPool()
+{
+	free();
+}
+
+bool zThreadPool::resize(int n)
+{
+	char name[16];
+
+	if(mLock == NULL)
+	{
+		mLock = SDL_CreateMutex();
+		mWork = SDL_CreateCond();
+		mDone = SDL_CreateCond();
+		if(mLock == NULL || mWork == NULL || mDone == NULL)
+			return false;
+	}
+
+	/* workers past the new size see it and quit, between jobs since run() waits for them */
+	SDL_LockMutex(mLock);
+	mSize = (n < (int)mWorkers.size()) ? n : (int)mWorkers.size();
+	SDL_CondBroadcast(mWork);
+	SDL_UnlockMutex(mLock);
+	while((int)mWorkers.size() > mSize)
+	{
+		SDL_WaitThread(mWorkers.back()->thread, NULL);
+		delete mWorkers.back();
+		mWorkers.pop_back();
+	}
+
+	while((int)mWorkers.size() < n)
+	{
+		zWorker* w = new zWorker;
+		w->pool = this;
+		w->index = (int)mWorkers.size();
+		SDL_LockMutex(mLock);
+		mSize = w->index+1;
+		SDL_UnlockMutex(mLock);
+		sprintf(name, "T%d", w->index);
+		w->thread = SDL_CreateThread(work, name, (void*)w);
+		if(w->thread == NULL)
+		{
+			delete w;
+			SDL_LockMutex(mLock);
+			mSize = (int)mWorkers.size();
+			SDL_UnlockMutex(mLock);
+			return false;
+		}
+		mWorkers.push_back(w);
+	}
+	return true;
+}
+
+void zThreadPool::free()
+{
+	if(mLock == NULL)
+		return;
+	resize(0);
+	SDL_DestroyCond(mDone);
+	SDL_DestroyCond(mWork);
+	SDL_DestroyMutex(mLock);
+	mDone = NULL;
+	mWork = NULL;
+	mLock = NULL;
+}
+
+int zThreadPool::getSize()
+{
+	return (int)mWorkers.size();
+}
+
+void zThreadPool::run(SDL_ThreadFunction job, void** data, int count)
+{
+	if(mWorkers.empty())
+	{
+		/* nobody to hand it to */
+		for(int i=0; i<count; i++)
+			job(data[i]);
+		return;
+	}
+
+	SDL_LockMutex(mLock);
+	mJob = job;
+	mData = data;
+	mCount = count;
+	mNext = 0;
+	mPending = count;
+	SDL_CondBroadcast(mWork);
+	while(mPending > 0)
+		SDL_CondWait(mDone, mLock);
+	mJob = NULL;
+	mData = NULL;
+	mCount = mNext = 0;
+	SDL_UnlockMutex(mLock);
+}
+
+int zThreadPool::work(void* ptr)
+{
+	zWorker* w = (zWorker*)ptr;
+	zThreadPool* pool = w->pool;
+
+	SDL_LockMutex(pool->mLock);
+	while(true)
+	{
+		while(w->index < pool->mSize && pool->mNext == pool->mCount)
+			SDL_CondWait(pool->mWork, pool->mLock);
+		if(w->index >= pool->mSize)
+			break;
+		SDL_ThreadFunction job = pool->mJob;
+		void* data = pool->mData[pool->mNext++];
+		SDL_UnlockMutex(pool->mLock);
+		job(data);
+		SDL_LockMutex(pool->mLock);
+		if(--pool->mPending == 0)
+			SDL_CondSignal(pool->mDone);
+	}
+	SDL_UnlockMutex(pool->mLock);
+	return 0;
+}
+
+
+
+
+zTileScheduler::zTileScheduler()
+{
+	mX0 = mY0 = 0;
+	mX1 = mY1 = -1;
+	mSize = 1;
+	mColumns = 0;
+}
+
+void zTileScheduler::init(int x0, int y0, int x1, int y1, int size, int n)
+{
+	mX0 = x0;
+	mY0 = y0;
+	mX1 = x1;
+	mY1 = y1;
+	mSize = size;
+	mColumns = (x1-x0+size)/size;
+	int tiles = mColumns*((y1-y0+size)/size);
+
+	/* neighboring tiles stay together until they're stolen */
+	mDeques.resize(n);
+	for(int k=0; k<n; k++)
+	{
+		mDeques[k].head = (int)(((Sint64)tiles*k)/n);
+		mDeques[k].tail = (int)(((Sint64)tiles*(k+1))/n);
+		mDeques[k].lock = 0;
+	}
+}
+
+bool zTileScheduler::next(int k, SDL_Rect* tile)
+{
+	int n = (int)mDeques.size(), t = -1;
+
+	SDL_AtomicLock(&mDeques[k].lock);
+	if(mDeques[k].head < mDeques[k].tail)
+		t = mDeques[k].head++;
+	SDL_AtomicUnlock(&mDeques[k].lock);
+
+	/* steal from the others, starting from the next one, the tile the owner would get to last */
+	for(int v=(k+1)%n; t < 0 && v != k; v=(v+1)%n)
+	{
+		SDL_AtomicLock(&mDeques[v].lock);
+		if(mDeques[v].head < mDeques[v].tail)
+			t = --mDeques[v].tail;
+		SDL_AtomicUnlock(&mDeques[v].lock);
+	}
+	if(t < 0)
+		return false;
+
+	tile->x = mX0 + (t%mColumns)*mSize;
+	tile->y = mY0 + (t/mColumns)*mSize;
+	tile->w = (tile->x + mSize-1 <= mX1) ? mSize : mX1-tile->x+1;
+	tile->h = (tile->y + mSize-1 <= mY1) ? mSize : mY1-tile->y+1;
+	return true;
+}
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <SDL_ttf.h>
 #include <SDL_mixer.h>
 #include <string>
+#include <vector>
 
 
 
@@ -234,3 +235,90 @@ class zLabel : public zBaseTexture
 		SDL_Color mBColor;
 		std::string mText;
 };
+
+
+
+
+/* worker thread pool */
+class zThreadPool
+{
+	public:
+		//Initializes variables
+		zThreadPool();
+
+		//Deallocates memory
+		~zThreadPool();
+
+		//Starts or stops workers until there are n, returns false if some couldn't be started
+		bool resize(int n);
+
+		//Stops every worker
+		void free();
+
+		//Number of workers
+		int getSize();
+
+		//Runs job(data[i]) for every i < count on the workers, returns once they're all done
+		void run(SDL_ThreadFunction job, void** data, int count);
+
+	private:
+		struct zWorker
+		{
+			zThreadPool* pool;
+			int index; //stops once the pool is resized to index workers or fewer
+			SDL_Thread* thread;
+		};
+
+		//Worker thread body: waits for jobs until stopped
+		static int work(void* ptr);
+
+		//Workers, the first mSize of them running
+		std::vector<zWorker*> mWorkers;
+		int mSize;
+
+		//Guards everything below
+		SDL_mutex* mLock;
+		SDL_cond* mWork;
+		SDL_cond* mDone;
+
+		//Job being run, data[mNext] is the next one to take and mPending haven't finished yet
+		SDL_ThreadFunction mJob;
+		void** mData;
+		int mCount;
+		int mNext;
+		int mPending;
+};
+
+
+
+
+/* tiles of a rectangle, dealt to workers which steal them from each other once they run out */
+class zTileScheduler
+{
+	public:
+		//Initializes variables
+		zTileScheduler();
+
+		//Splits [x0, x1]x[y0, y1] in tiles of size x size pixels (cut short along the right and bottom edges), dealt to n workers
+		//in contiguous runs
+		void init(int x0, int y0, int x1, int y1, int size, int n);
+
+		//Takes the next tile of worker k, from the front of its own deque or else from the back of another's,
+		//returns false once there are none left
+		bool next(int k, SDL_Rect* tile);
+
+	private:
+		//Tiles head to tail-1 of mDeques[k] are left to worker k, each deque under its own lock
+		struct zDeque
+		{
+			int head;
+			int tail;
+			SDL_SpinLock lock;
+		};
+		std::vector<zDeque> mDeques;
+
+		//Tile grid
+		int mX0, mY0, mX1, mY1;
+		int mSize;
+		int mColumns;
+};
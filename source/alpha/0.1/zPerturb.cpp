@@ -0,0 +1,1055 @@
+/*
+zPerturb, perturbation kernels for deep zooms in zMand.
+See zPerturb.h for info about copyright.
+*/
+
+#include "zPerturb.h"
+
+
+static const char* approximationNames[NUM_APPROX] = {"none", "series", "BLA"};
+static const char* glitchModeNames[NUM_GLITCH_MODES] = {"references", "rebasing"};
+static const char* engineNames[NUM_ENGINES] = {"float", "double", "double-double", "perturbation", "perturbation (floatexp)"};
+
+/* cost of an iteration of each engine, for every instruction set level, against the scalar double kernel (measured) */
+static const double iterationCost[NUM_ISA][NUM_ENGINES] =
+{
+	{1.0, 1.0, 7.1, 1.2, 6.0}, //the float kernel is the double one
+	{0.29, 0.58, 7.1, 1.2, 6.0}, //the double-double kernel is scalar before AVX2
+	{0.13, 0.3, 1.5, 0.4, 6.0}, //perturbation iterates 4 pixels at a time from AVX2, 8 with AVX-512
+	{0.09, 0.18, 1.2, 0.27, 6.0}
+};
+static const double REFERENCE_LIMB_COST = 2.0; //of a reference iteration, per squared limb
+
+/* precisions (fraction limbs) reference orbits are compiled for */
+typedef void (*referenceFunc)(zReferenceOrbit*, Uint32);
+template<int N> static void iterateReferenceN(zReferenceOrbit* orbit, Uint32 maxIt);
+static const int REFERENCE_SIZES = 12;
+static const int referenceLimbs[REFERENCE_SIZES] = {2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 32};
+static const referenceFunc referenceTable[REFERENCE_SIZES] =
+{
+	iterateReferenceN<2>, iterateReferenceN<3>, iterateReferenceN<4>, iterateReferenceN<5>, iterateReferenceN<6>, iterateReferenceN<8>,
+	iterateReferenceN<10>, iterateReferenceN<12>, iterateReferenceN<16>, iterateReferenceN<20>, iterateReferenceN<24>, iterateReferenceN<32>
+};
+
+/* same precisions for nuclei */
+struct newtonStep;
+typedef Uint32 (*periodFunc)(const zFixed&, const zFixed&, const zFloatExp&, Uint32, bool (*)());
+typedef void (*newtonFunc)(const zFixed&, const zFixed&, Uint32, newtonStep*);
+template<int N> static Uint32 findPeriodN(const zFixed& cr, const zFixed& ci, const zFloatExp& radius, Uint32 maxIt, bool (*cancelled)());
+template<int N> static void newtonStepN(const zFixed& cr, const zFixed& ci, Uint32 period, newtonStep* s);
+static const periodFunc periodTable[REFERENCE_SIZES] =
+{
+	findPeriodN<2>, findPeriodN<3>, findPeriodN<4>, findPeriodN<5>, findPeriodN<6>, findPeriodN<8>,
+	findPeriodN<10>, findPeriodN<12>, findPeriodN<16>, findPeriodN<20>, findPeriodN<24>, findPeriodN<32>
+};
+static const newtonFunc newtonTable[REFERENCE_SIZES] =
+{
+	newtonStepN<2>, newtonStepN<3>, newtonStepN<4>, newtonStepN<5>, newtonStepN<6>, newtonStepN<8>,
+	newtonStepN<10>, newtonStepN<12>, newtonStepN<16>, newtonStepN<20>, newtonStepN<24>, newtonStepN<32>
+};
+static const double FLOATEXP_BELOW = 1e-140; //fixed-point values below this are converted to zFloatExp exactly, their squares would underflow doubles
+
+
+
+bool doublePrecisionSuffices(double x0, double y0, double x1, double y1, double spanfactor)
+{
+	/* same reasoning as singlePrecisionSuffices() */
+	double magnitude = fmax(fmax(fmax(fabs(x0), fabs(x1)), fmax(fabs(y0), fabs(y1))), 2.0);
+	return spanfactor >= DOUBLE_MIN_SPACING*magnitude;
+}
+
+const char* approximationName(int approx)
+{
+	return (approx >= 0 && approx < NUM_APPROX) ? approximationNames[approx] : "unknown";
+}
+
+const char* glitchModeName(int mode)
+{
+	return (mode >= 0 && mode < NUM_GLITCH_MODES) ? glitchModeNames[mode] : "unknown";
+}
+
+const char* engineName(int engine)
+{
+	return (engine >= 0 && engine < NUM_ENGINES) ? engineNames[engine] : "unknown";
+}
+
+double engineCost(int engine, double x0, double y0, double x1, double y1, const zFloatExp& spanfactor, int n, Uint32 maxIt)
+{
+	double sf = spanfactor.toDouble();
+	bool admissible = false;
+	switch(engine)
+	{
+		case ENGINE_FLOAT:
+			admissible = singlePrecisionSuffices(x0, y0, x1, y1, sf);
+			break;
+		case ENGINE_DOUBLE:
+			admissible = doublePrecisionSuffices(x0, y0, x1, y1, sf);
+			break;
+		case ENGINE_DOUBLEDOUBLE:
+			admissible = doubleDoublePrecisionSuffices(x0, y0, x1, y1, sf);
+			break;
+		case ENGINE_PERTURB: //only needed past double precision
+			admissible = !doublePrecisionSuffices(x0, y0, x1, y1, sf) && spanfactor.e >= DOUBLE_MIN_EXPONENT;
+			break;
+		case ENGINE_PERTURB_FLOATEXP:
+			admissible = spanfactor.e < DOUBLE_MIN_EXPONENT;
+			break;
+	}
+	if(!admissible)
+		return HUGE_VAL;
+
+	/* every pixel is assumed to take the whole budget, the reference too */
+	double cost = (double)n*maxIt*iterationCost[getIsa()][engine];
+	if(engine == ENGINE_PERTURB || engine == ENGINE_PERTURB_FLOATEXP)
+	{
+		double limbs = fractionLimbs(spanfactor) + 1;
+		cost += (double)maxIt*REFERENCE_LIMB_COST*limbs*limbs;
+	}
+	return cost;
+}
+
+int selectEngine(double x0, double y0, double x1, double y1, const zFloatExp& spanfactor, int n, Uint32 maxIt, bool singlePrecision, double* cost)
+{
+	int best = ENGINE_PERTURB_FLOATEXP;
+	*cost = HUGE_VAL;
+	for(int engine=0; engine<NUM_ENGINES; engine++)
+	{
+		if(engine == ENGINE_FLOAT && !singlePrecision)
+			continue;
+		double c = engineCost(engine, x0, y0, x1, y1, spanfactor, n, maxIt);
+		if(c < *cost)
+		{
+			best = engine;
+			*cost = c;
+		}
+	}
+	return best;
+}
+
+// Z = Z^2 + C, in doubles: how compressed orbits are read between waypoints
+static inline void stepOrbit(double* zr, double* zi, double cr, double ci)
+{
+	double tempRe = (*zr)*(*zr) - (*zi)*(*zi) + cr;
+	*zi = (*zr)*(*zi)*2.0 + ci;
+	*zr = tempRe;
+}
+
+Uint32 zReferenceOrbit::length() const
+{
+	return count;
+}
+
+bool zReferenceOrbit::escaped() const
+{
+	return lastRe*lastRe + lastIm*lastIm > RADIUS2;
+}
+
+bool zReferenceOrbit::compressed() const
+{
+	return !waypoints.empty();
+}
+
+size_t zReferenceOrbit::memory() const
+{
+	return (re.size() + im.size())*sizeof(double) + waypoints.size()*sizeof(zOrbitWaypoint);
+}
+
+void zReferenceOrbit::clear()
+{
+	re.clear();
+	im.clear();
+	waypoints.clear();
+	count = 0;
+}
+
+void zReferenceOrbit::append(double r, double i)
+{
+	if(!compressed() && count == ORBIT_COMPRESS_LENGTH)
+	{
+		/* too long: what's stored is compressed as well, then freed */
+		std::vector<double> storedRe, storedIm;
+		storedRe.swap(re);
+		storedIm.swap(im);
+		for(count=0; count<(Uint32)storedRe.size(); count++)
+		{
+			compress(storedRe[count], storedIm[count]);
+		}
+	}
+	if(compressed())
+	{
+		compress(r, i);
+	}
+	else
+	{
+		re.push_back(r);
+		im.push_back(i);
+	}
+	lastRe = r;
+	lastIm = i;
+	count++;
+}
+
+void zReferenceOrbit::compress(double r, double i)
+{
+	/* Z_count as it would be read, a waypoint if that's too far */
+	double zr = driftRe, zi = driftIm;
+	stepOrbit(&zr, &zi, dcr, dci);
+	double er = zr - r, ei = zi - i;
+	if(count == 0 || !(er*er + ei*ei <= ORBIT_TOLERANCE*ORBIT_TOLERANCE*(r*r + i*i)))
+	{
+		zOrbitWaypoint w = {count, r, i};
+		waypoints.push_back(w);
+		zr = r;
+		zi = i;
+	}
+	driftRe = zr;
+	driftIm = zi;
+}
+
+/* orbits are read through one of these, Z_m for any m < length(), or Z_m..Z_m+count in a row (in the buffers, of
+   count+1 values, if they aren't stored as such) */
+
+// Z_m of a stored orbit
+struct storedOrbit
+{
+	const double* re;
+	const double* im;
+
+	storedOrbit(const zReferenceOrbit* orbit) : re(&orbit->re[0]), im(&orbit->im[0]) {}
+
+	inline void get(Uint32 m, double* zr, double* zi)
+	{
+		*zr = re[m];
+		*zi = im[m];
+	}
+
+	inline void block(Uint32 m, Uint32, double*, double*, const double** zr, const double** zi)
+	{
+		*zr = re+m;
+		*zi = im+m;
+	}
+};
+
+// Z_m of a compressed orbit, iterated from the last waypoint before it: reading in order is an iteration per Z_m,
+// anything else goes back to a waypoint first
+struct compressedOrbit
+{
+	const zOrbitWaypoint* waypoint;
+	size_t waypoints;
+	double cr, ci;
+	Uint32 n; //last read
+	size_t next; //first waypoint past n
+	double zr, zi; //Z_n
+
+	compressedOrbit(const zReferenceOrbit* orbit) : waypoint(&orbit->waypoints[0]), waypoints(orbit->waypoints.size()),
+		cr(orbit->dcr), ci(orbit->dci), n(0), next(1), zr(0.0), zi(0.0) {}
+
+	inline void get(Uint32 m, double* r, double* i)
+	{
+		if(m < n || (next+1 < waypoints && waypoint[next+1].n <= m))
+			seek(m);
+		else if(next < waypoints && waypoint[next].n <= m)
+		{
+			n = waypoint[next].n;
+			zr = waypoint[next].re;
+			zi = waypoint[next].im;
+			next++;
+		}
+		while(n < m)
+		{
+			n++;
+			stepOrbit(&zr, &zi, cr, ci);
+		}
+		*r = zr;
+		*i = zi;
+	}
+
+	inline void block(Uint32 m, Uint32 count, double* bufRe, double* bufIm, const double** r, const double** i)
+	{
+		for(Uint32 k=0; k<=count; k++)
+			get(m+k, bufRe+k, bufIm+k);
+		*r = bufRe;
+		*i = bufIm;
+	}
+
+	void seek(Uint32 m)
+	{
+		/* binary search of the last waypoint up to m */
+		size_t lo = 0, hi = waypoints;
+		while(hi-lo > 1)
+		{
+			size_t mid = (lo+hi)/2;
+			if(waypoint[mid].n <= m)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		n = waypoint[lo].n;
+		zr = waypoint[lo].re;
+		zi = waypoint[lo].im;
+		next = lo+1;
+	}
+};
+
+// a zero with the precision of x
+static inline zFixed zeroLike(const zFixed& x)
+{
+	return zFixed(x.getLimbs());
+}
+
+template<int N>
+static inline zFixedN<N> zeroLike(const zFixedN<N>&)
+{
+	return zFixedN<N>();
+}
+
+// x as a zFixed, exactly
+static inline zFixed toFixed(const zFixed& x)
+{
+	return x;
+}
+
+template<int N>
+static inline zFixed toFixed(const zFixedN<N>& x)
+{
+	return x.toFixed();
+}
+
+// Z = Z^2 + C, zr2, zi2 and t are scratch
+template<class F>
+static inline void stepFixed(F& zr, F& zi, const F& cr, const F& ci, F& zr2, F& zi2, F& t)
+{
+	/* 2*zr*zi = (zr + zi)^2 - zr^2 - zi^2, three squares instead of two products */
+	t.setSum(zr, zi);
+	t.setSquare(t);
+	zr2.setSquare(zr);
+	zi2.setSquare(zi);
+	t.setDifference(t, zr2);
+	zi.setDifference(t, zi2);
+	zi.setSum(zi, ci);
+	zr.setDifference(zr2, zi2);
+	zr.setSum(zr, cr);
+}
+
+// x as a zFloatExp, through doubles unless it's too small for them
+template<class F>
+static inline zFloatExp toFloatExp(const F& x)
+{
+	double d = x.toDouble();
+	return (fabs(d) >= FLOATEXP_BELOW) ? zFloatExp(d) : toFixed(x).toFloatExp();
+}
+
+// appends Z_n+1, Z_n+2... to the orbit going as far as Z_n = zr + zi*i, until it escapes or Z_maxIt+1
+template<class F>
+static inline void iterateReference(zReferenceOrbit* orbit, const F& cr, const F& ci, F zr, F zi, Uint32 maxIt)
+{
+	F zr2 = zeroLike(cr), zi2 = zr2, t = zr2;
+	double r, i;
+
+	for(Uint32 n=orbit->length()-1; n<=maxIt; n++)
+	{
+		stepFixed(zr, zi, cr, ci, zr2, zi2, t);
+		r = zr.toDouble();
+		i = zi.toDouble();
+		orbit->append(r, i);
+		if(r*r + i*i > RADIUS2)
+			break;
+	}
+	orbit->zr = toFixed(zr);
+	orbit->zi = toFixed(zi);
+}
+
+template<int N>
+static void iterateReferenceN(zReferenceOrbit* orbit, Uint32 maxIt)
+{
+	iterateReference(orbit, zFixedN<N>(orbit->cr), zFixedN<N>(orbit->ci), zFixedN<N>(orbit->zr), zFixedN<N>(orbit->zi), maxIt);
+}
+
+void computeReference(zReferenceOrbit* orbit, const zFixed& cr, const zFixed& ci, Uint32 maxIt)
+{
+	int limbs = cr.getLimbs();
+
+	orbit->cr = cr;
+	orbit->ci = ci;
+	orbit->ci.setLimbs(limbs);
+	orbit->dcr = cr.toDouble();
+	orbit->dci = ci.toDouble();
+	orbit->clear();
+	orbit->append(0.0, 0.0);
+	orbit->zr = zFixed(limbs);
+	orbit->zi = zFixed(limbs);
+	extendReference(orbit, maxIt);
+}
+
+void extendReference(zReferenceOrbit* orbit, Uint32 maxIt)
+{
+	int limbs = orbit->cr.getLimbs();
+	if(orbit->escaped() || orbit->length() > maxIt+1)
+		return;
+
+	/* the smallest compiled precision that covers cr, or zFixed past the largest one */
+	for(int k=0; k<REFERENCE_SIZES; k++)
+	{
+		if(limbs <= referenceLimbs[k])
+		{
+			referenceTable[k](orbit, maxIt);
+			return;
+		}
+	}
+	iterateReference(orbit, orbit->cr, orbit->ci, orbit->zr, orbit->zi, maxIt);
+}
+
+zReferenceCache::zReferenceCache(Uint64 capacity)
+{
+	this->capacity = capacity;
+}
+
+const zReferenceOrbit* zReferenceCache::get(const zFixed& cr, const zFixed& ci, Uint32 maxIt, bool* cached)
+{
+	/* an orbit of C' with more limbs is as good as the one of C if C' truncated is C: they're less than an ulp of C apart */
+	int limbs = cr.getLimbs();
+	std::list<zReferenceOrbit>::iterator it;
+	for(it=orbits.begin(); it!=orbits.end(); it++)
+	{
+		if(it->cr.getLimbs() < limbs)
+			continue;
+		zFixed r(it->cr), i(it->ci);
+		r.setLimbs(limbs);
+		i.setLimbs(limbs);
+		if((r - cr).isZero() && (i - ci).isZero())
+			break;
+	}
+
+	*cached = (it != orbits.end());
+	if(*cached)
+	{
+		orbits.splice(orbits.begin(), orbits, it);
+		extendReference(&orbits.front(), maxIt);
+	}
+	else
+	{
+		orbits.push_front(zReferenceOrbit());
+		computeReference(&orbits.front(), cr, ci, maxIt);
+	}
+
+	/* the oldest orbits go first */
+	Uint64 total = 0;
+	for(it=orbits.begin(); it!=orbits.end(); it++)
+	{
+		total += it->memory();
+	}
+	while(orbits.size() > 1 && total > capacity)
+	{
+		total -= orbits.back().memory();
+		orbits.pop_back();
+	}
+	return &orbits.front();
+}
+
+void zReferenceCache::clear()
+{
+	orbits.clear();
+}
+
+/* nuclei: the period comes from a disk around the view, then Newton's method solves Z_period(C) = 0 */
+
+template<class F>
+static Uint32 periodOf(const F& cr, const F& ci, const zFloatExp& radius, Uint32 maxIt, bool (*cancelled)())
+{
+	F zr = zeroLike(cr), zi = zr, zr2 = zr, zi2 = zr, t = zr;
+	zFloatExp fr, fi, dr, di, tempRe, r2 = radius*radius;
+
+	for(Uint32 n=1; n<=maxIt; n++)
+	{
+		/* dZ_n+1 = 2*Z_n*dZ_n + 1: the disk maps to about the one of radius |dZ_n|*radius around Z_n */
+		tempRe = zFloatExp(2.0)*(fr*dr - fi*di) + zFloatExp(1.0);
+		di = zFloatExp(2.0)*(fr*di + fi*dr);
+		dr = tempRe;
+		stepFixed(zr, zi, cr, ci, zr2, zi2, t);
+		fr = toFloatExp(zr);
+		fi = toFloatExp(zi);
+		if(fr*fr + fi*fi < (dr*dr + di*di)*r2)
+			return n;
+		if(fr*fr + fi*fi > zFloatExp(RADIUS2)) //C escaped first
+			return 0;
+		if(cancelled != NULL && cancelled())
+			return 0;
+	}
+	return 0;
+}
+
+template<int N>
+static Uint32 findPeriodN(const zFixed& cr, const zFixed& ci, const zFloatExp& radius, Uint32 maxIt, bool (*cancelled)())
+{
+	return periodOf(zFixedN<N>(cr), zFixedN<N>(ci), radius, maxIt, cancelled);
+}
+
+Uint32 findPeriod(const zFixed& cr, const zFixed& ci, const zFloatExp& radius, Uint32 maxIt, bool (*cancelled)())
+{
+	int limbs = cr.getLimbs();
+	zFixed i(ci);
+	i.setLimbs(limbs);
+	for(int k=0; k<REFERENCE_SIZES; k++)
+	{
+		if(limbs <= referenceLimbs[k])
+			return periodTable[k](cr, i, radius, maxIt, cancelled);
+	}
+	return periodOf(cr, i, radius, maxIt, cancelled);
+}
+
+// what a Newton step needs from C
+struct newtonStep
+{
+	zFloatExp zr, zi; //Z_period
+	zFloatExp dr, di; //dZ_period/dC
+	zFloatExp size; //estimated radius of the component, if C is its nucleus
+	bool escaped; //Z_n escaped before the period, nothing else is set
+};
+
+template<class F>
+static void newtonOf(const F& cr, const F& ci, Uint32 period, newtonStep* s)
+{
+	F zr = zeroLike(cr), zi = zr, zr2 = zr, zi2 = zr, t = zr;
+	zFloatExp fr, fi, dr, di, lr(1.0), li, br(1.0), bi, tempRe, l2;
+
+	/* dZ_n+1 = 2*Z_n*dZ_n + 1. The size is 1/(b*l^2), l being the product of 2*Z_n and b = 1 + the sum of 1/l
+	 * as it grows, for 0 < n < period */
+	for(Uint32 n=0; n<period; n++)
+	{
+		fr = toFloatExp(zr);
+		fi = toFloatExp(zi);
+		tempRe = zFloatExp(2.0)*(fr*dr - fi*di) + zFloatExp(1.0);
+		di = zFloatExp(2.0)*(fr*di + fi*dr);
+		dr = tempRe;
+		stepFixed(zr, zi, cr, ci, zr2, zi2, t);
+		fr = toFloatExp(zr);
+		fi = toFloatExp(zi);
+		if(fr*fr + fi*fi > zFloatExp(RADIUS2))
+		{
+			s->escaped = true;
+			return;
+		}
+		if(n+1 < period)
+		{
+			tempRe = zFloatExp(2.0)*(fr*lr - fi*li);
+			li = zFloatExp(2.0)*(fr*li + fi*lr);
+			lr = tempRe;
+			l2 = lr*lr + li*li;
+			if(l2.e != FLOATEXP_ZERO) //unless the orbit went through 0 before the period
+			{
+				br = br + lr/l2;
+				bi = bi - li/l2;
+			}
+		}
+	}
+	s->escaped = false;
+	s->zr = fr;
+	s->zi = fi;
+	s->dr = dr;
+	s->di = di;
+	s->size = zFloatExp(1.0)/(sqrt(br*br + bi*bi)*(lr*lr + li*li));
+}
+
+template<int N>
+static void newtonStepN(const zFixed& cr, const zFixed& ci, Uint32 period, newtonStep* s)
+{
+	newtonOf(zFixedN<N>(cr), zFixedN<N>(ci), period, s);
+}
+
+bool findNucleus(zFixed* cr, zFixed* ci, Uint32 period, zFloatExp* size, bool (*cancelled)())
+{
+	int limbs = cr->getLimbs();
+	newtonStep s;
+	zFloatExp d2, dcr, dci;
+	zFixed lastR, lastI; //C before the last step
+	zFloatExp shortest(4.0); //step, since it last got shorter
+	bool stepped = false;
+
+	ci->setLimbs(limbs);
+	for(int stalled=0; stalled<NUCLEUS_MAX_STEPS; stalled++)
+	{
+		if(cancelled != NULL && cancelled())
+			return false;
+		int k = 0;
+		while(k < REFERENCE_SIZES && limbs > referenceLimbs[k])
+			k++;
+		if(k < REFERENCE_SIZES)
+			newtonTable[k](*cr, *ci, period, &s);
+		else
+			newtonOf(*cr, *ci, period, &s);
+		if(s.escaped)
+		{
+			/* the last step went too far out: half of it */
+			if(!stepped)
+				return false;
+			dcr = zFloatExp(0.5)*dcr;
+			dci = zFloatExp(0.5)*dci;
+			cr->setDifference(lastR, zFixed(dcr, limbs));
+			ci->setDifference(lastI, zFixed(dci, limbs));
+			continue;
+		}
+		*size = s.size;
+
+		/* C -= Z_period/dZ_period */
+		d2 = s.dr*s.dr + s.di*s.di;
+		if(d2.e == FLOATEXP_ZERO || !(s.size.m > 0.0 && s.size.m < HUGE_VAL))
+			return false;
+		dcr = (s.zr*s.dr + s.zi*s.di)/d2;
+		dci = (s.zi*s.dr - s.zr*s.di)/d2;
+		if(!(dcr.abs() < zFloatExp(4.0) && dci.abs() < zFloatExp(4.0))) //gone off the set
+			return false;
+		if(dcr.abs() + dci.abs() < shortest)
+		{
+			/* a step gains about as many bits as doubles hold: deep nuclei take many, but each one shorter */
+			shortest = dcr.abs() + dci.abs();
+			stalled = 0;
+		}
+		lastR = *cr;
+		lastI = *ci;
+		stepped = true;
+		cr->setDifference(*cr, zFixed(dcr, limbs));
+		ci->setDifference(*ci, zFixed(dci, limbs));
+
+		/* converged once steps are down to the last limb but one, then the component may need more limbs */
+		if(dcr.abs() + dci.abs() < zFloatExp(1.0, -LIMB_BITS*(limbs-1)))
+		{
+			int needed = fractionLimbs(s.size*zFloatExp(1.0, -LIMB_BITS));
+			if(needed <= limbs)
+				return true;
+			limbs = needed;
+			cr->setLimbs(limbs);
+			ci->setLimbs(limbs);
+			stepped = false;
+		}
+	}
+	return false;
+}
+
+// series at t = tr + ti*i, Horner's rule
+static inline void evaluateSeries(const zSeries* series, const zFloatExp& tr, const zFloatExp& ti, zFloatExp* sr, zFloatExp* si)
+{
+	zFloatExp r = series->ar[SERIES_TERMS-1], i = series->ai[SERIES_TERMS-1], tempRe;
+	for(int k=SERIES_TERMS-2; k>=0; k--)
+	{
+		tempRe = r*tr - i*ti + series->ar[k];
+		i = r*ti + i*tr + series->ai[k];
+		r = tempRe;
+	}
+	*sr = r*tr - i*ti;
+	*si = r*ti + i*tr;
+}
+
+template<class R>
+static void computeSeriesWith(R Z, zSeries* series, const zReferenceOrbit* orbit, const zFloatExp& dcX0, const zFloatExp& dcY0, const zFloatExp& dcX1, const zFloatExp& dcY1, const zFloatExp& scale, Uint32 maxIt)
+{
+	const int PROBES = 8;
+	Uint32 last = orbit->length()-1;
+	zFloatExp dcXm = zFloatExp(0.5)*(dcX0 + dcX1), dcYm = zFloatExp(0.5)*(dcY0 + dcY1);
+	zFloatExp pr[PROBES] = {dcX0, dcXm, dcX1, dcX0, dcX1, dcX0, dcXm, dcX1};
+	zFloatExp pi[PROBES] = {dcY0, dcY0, dcY0, dcYm, dcYm, dcY1, dcY1, dcY1};
+	zFloatExp dzr[PROBES], dzi[PROBES];
+	zFloatExp nr[SERIES_TERMS], ni[SERIES_TERMS];
+	zFloatExp zr2, zi2, ar, ai, tempRe, sr, si, er, ei;
+	const zFloatExp tolerance2 = zFloatExp(SERIES_TOLERANCE*SERIES_TOLERANCE);
+	double zr, zi, Zr, Zi, Zr1, Zi1;
+
+	/* dz_1 = dc */
+	series->skip = 1;
+	series->scale = scale;
+	for(int k=0; k<SERIES_TERMS; k++)
+	{
+		series->ar[k] = series->ai[k] = zFloatExp();
+	}
+	series->ar[0] = scale;
+	for(int p=0; p<PROBES; p++)
+	{
+		dzr[p] = pr[p];
+		dzi[p] = pi[p];
+	}
+
+	for(Uint32 n=1; n<maxIt && n+2<=last; n++)
+	{
+		/* a_k,n+1 = 2*Z_n*a_k,n + sum of a_j,n*a_k-1-j,n (+ scale for the linear term) */
+		Z.get(n, &Zr, &Zi);
+		Z.get(n+1, &Zr1, &Zi1);
+		zr2 = zFloatExp(2.0*Zr);
+		zi2 = zFloatExp(2.0*Zi);
+		for(int k=0; k<SERIES_TERMS; k++)
+		{
+			nr[k] = zr2*series->ar[k] - zi2*series->ai[k];
+			ni[k] = zr2*series->ai[k] + zi2*series->ar[k];
+			for(int j=0; j<k; j++)
+			{
+				nr[k] = nr[k] + series->ar[j]*series->ar[k-1-j] - series->ai[j]*series->ai[k-1-j];
+				ni[k] = ni[k] + series->ar[j]*series->ai[k-1-j] + series->ai[j]*series->ar[k-1-j];
+			}
+		}
+		nr[0] = nr[0] + scale;
+
+		/* the probes must agree with the series at n+1, or dz_n is as far as it goes */
+		zSeries next = *series;
+		for(int k=0; k<SERIES_TERMS; k++)
+		{
+			next.ar[k] = nr[k];
+			next.ai[k] = ni[k];
+		}
+		for(int p=0; p<PROBES; p++)
+		{
+			ar = zr2 + dzr[p];
+			ai = zi2 + dzi[p];
+			tempRe = ar*dzr[p] - ai*dzi[p] + pr[p];
+			dzi[p] = ar*dzi[p] + ai*dzr[p] + pi[p];
+			dzr[p] = tempRe;
+			zr = Zr1 + dzr[p].toDouble();
+			zi = Zi1 + dzi[p].toDouble();
+			if(zr*zr + zi*zi > RADIUS2)
+				return;
+			evaluateSeries(&next, pr[p]/scale, pi[p]/scale, &sr, &si);
+			er = sr - dzr[p];
+			ei = si - dzi[p];
+			if(!(er*er + ei*ei <= tolerance2*(dzr[p]*dzr[p] + dzi[p]*dzi[p])))
+				return;
+		}
+		*series = next;
+		series->skip = n+1;
+	}
+}
+
+void computeSeries(zSeries* series, const zReferenceOrbit* orbit, const zFloatExp& dcX0, const zFloatExp& dcY0, const zFloatExp& dcX1, const zFloatExp& dcY1, const zFloatExp& scale, Uint32 maxIt)
+{
+	if(orbit->compressed())
+		computeSeriesWith(compressedOrbit(orbit), series, orbit, dcX0, dcY0, dcX1, dcY1, scale, maxIt);
+	else
+		computeSeriesWith(storedOrbit(orbit), series, orbit, dcX0, dcY0, dcX1, dcY1, scale, maxIt);
+}
+
+// x then y: dz -> ay*(ax*dz + bx*dc) + by*dc, as long as |dz| < rx and |ax*dz + bx*dc| < ry
+static inline zBlaStep mergeBla(const zBlaStep& x, const zBlaStep& y, const zFloatExp& dcMax)
+{
+	zBlaStep s;
+	s.ar = y.ar*x.ar - y.ai*x.ai;
+	s.ai = y.ar*x.ai + y.ai*x.ar;
+	s.br = y.ar*x.br - y.ai*x.bi + y.br;
+	s.bi = y.ar*x.bi + y.ai*x.br + y.bi;
+	double ax = sqrt(x.ar*x.ar + x.ai*x.ai);
+	s.r = (ax > 0.0) ? fmin(x.r, fmax(0.0, (y.r - (zFloatExp(sqrt(x.br*x.br + x.bi*x.bi))*dcMax).toDouble())/ax)) : 0.0;
+	return s;
+}
+
+template<class R>
+static void computeBlaWith(R Z, zBlaTable* table, const zReferenceOrbit* orbit, const zFloatExp& dcMax)
+{
+	Uint32 last = orbit->length()-1;
+	std::vector< std::vector<zBlaStep> > level(1); //every level kept, from BLA_MIN_LEVEL
+	zBlaStep pending[BLA_MIN_LEVEL]; //pending[l] is a block of 2^l steps waiting for the next one, if bit l of blocks is set
+	Uint32 blocks = 0;
+	zBlaStep s;
+	double Zr, Zi;
+
+	/* single steps from Z_m: a = 2*Z_m, b = 1, as long as dz_m^2 is negligible next to 2*Z_m*dz_m.
+	 * They're merged as they come, like the digits of a binary counter: the levels below BLA_MIN_LEVEL are never stored */
+	for(Uint32 m=1; m+1<=last; m++)
+	{
+		Z.get(m, &Zr, &Zi);
+		s.ar = 2.0*Zr;
+		s.ai = 2.0*Zi;
+		s.br = 1.0;
+		s.bi = 0.0;
+		s.r = BLA_TOLERANCE*sqrt(s.ar*s.ar + s.ai*s.ai);
+		int l = 0;
+		for(Uint32 b=blocks; b & 1; b >>= 1, l++)
+		{
+			s = mergeBla(pending[l], s, dcMax);
+		}
+		if(l == BLA_MIN_LEVEL)
+		{
+			level[0].push_back(s);
+			blocks = 0;
+		}
+		else
+		{
+			pending[l] = s;
+			blocks++;
+		}
+	}
+
+	while(level.back().size() >= 2)
+	{
+		const std::vector<zBlaStep>& prev = level.back();
+		std::vector<zBlaStep> next(prev.size()/2);
+		for(size_t j=0; j<next.size(); j++)
+		{
+			next[j] = mergeBla(prev[2*j], prev[2*j+1], dcMax);
+		}
+		level.push_back(next);
+	}
+
+	table->levels.clear();
+	for(size_t l=0; l<level.size() && !level[l].empty(); l++)
+	{
+		table->levels.push_back(std::vector<zBlaStep>());
+		table->levels.back().swap(level[l]);
+	}
+}
+
+void computeBla(zBlaTable* table, const zReferenceOrbit* orbit, const zFloatExp& dcMax)
+{
+	if(orbit->compressed())
+		computeBlaWith(compressedOrbit(orbit), table, orbit, dcMax);
+	else
+		computeBlaWith(storedOrbit(orbit), table, orbit, dcMax);
+}
+
+/* the delta loop is written once, for doubles and for zFloatExp */
+
+static inline double toDouble(double d)
+{
+	return d;
+}
+
+static inline double toDouble(const zFloatExp& f)
+{
+	return f.toDouble();
+}
+
+// whether a difference from the reference has grown big enough for doubles
+static inline bool leavesExtendedRange(double, double)
+{
+	return false; //already in doubles
+}
+
+static inline bool leavesExtendedRange(const zFloatExp& dzr, const zFloatExp& dzi)
+{
+	return dzr.e >= DOUBLE_MIN_EXPONENT || dzi.e >= DOUBLE_MIN_EXPONENT;
+}
+
+// the longest valid bilinear approximation from dz_m within budget iterations, NULL if there's none
+template<class T>
+static inline const zBlaStep* findBla(const zBlaTable* bla, Uint32 m, Uint32 budget, const T& dz2, Uint32* steps)
+{
+	/* a block is never valid further than its first half, so go up from the shortest one until one fails */
+	int top = BLA_MIN_LEVEL + (int)bla->levels.size();
+	const zBlaStep* found = NULL;
+	for(int l=BLA_MIN_LEVEL; l<top; l++)
+	{
+		Uint32 j = (m-1) >> l;
+		if(((m-1) & ((1u<<l)-1)) || (1u<<l) > budget || j >= bla->levels[l-BLA_MIN_LEVEL].size()) //blocks at level l start from m = 1 + j*2^l
+			break;
+		const zBlaStep* s = &bla->levels[l-BLA_MIN_LEVEL][j];
+		if(!(dz2 < T(s->r)*T(s->r)))
+			break;
+		found = s;
+		*steps = 1u<<l;
+	}
+	return found;
+}
+
+// iterates dz, the difference of z_i+1 from Z_m, until the pixel escapes (setting nu) or glitches (setting glitched,
+// if not NULL), maxIt is reached, the reference ends (unless rebasing) or, in zFloatExp, dz grows big enough
+// for doubles; returns the iteration it stopped at
+template<class T, class R>
+static inline Uint32 perturbLoop(T& dzr, T& dzi, const T& dcr, const T& dci, Uint32 i, Uint32& m, R& Z, const zReferenceOrbit* orbit, const zBlaTable* bla, Uint32 maxIt, bool rebase, double* nu, Uint8* glitched, zKernelStats* stats)
+{
+	const double tolerance2 = GLITCH_TOLERANCE*GLITCH_TOLERANCE;
+	Uint32 last = orbit->length()-1; //the reference goes as far as Z_last
+	const zBlaStep* s;
+	T ar, ai, tempRe;
+	double Zr, Zi, dr, di, zr, zi, modulus2;
+	Uint32 steps;
+
+	Z.get(m, &Zr, &Zi);
+	for(; i<maxIt; i++)
+	{
+		if(leavesExtendedRange(dzr, dzi) || m == last)
+			break;
+		if(bla && m > 0 && (s = findBla(bla, m, maxIt-i, dzr*dzr + dzi*dzi, &steps)))
+		{
+			/* jump to dz_m+steps, escape is only checked there */
+			tempRe = T(s->ar)*dzr - T(s->ai)*dzi + T(s->br)*dcr - T(s->bi)*dci;
+			dzi = T(s->ar)*dzi + T(s->ai)*dzr + T(s->br)*dci + T(s->bi)*dcr;
+			dzr = tempRe;
+			i += steps-1;
+			m += steps;
+			stats->approximated += steps;
+		}
+		else
+		{
+			/* dz_m+1 = (2*Z_m + dz_m)*dz_m + dc */
+			ar = T(2.0*Zr) + dzr;
+			ai = T(2.0*Zi) + dzi;
+			tempRe = ar*dzr - ai*dzi + dcr;
+			dzi = ar*dzi + ai*dzr + dci;
+			dzr = tempRe;
+			m++;
+		}
+		Z.get(m, &Zr, &Zi);
+		dr = toDouble(dzr);
+		di = toDouble(dzi);
+		zr = Zr + dr;
+		zi = Zi + di;
+		if((modulus2 = zr*zr + zi*zi) > RADIUS2)
+		{
+			*nu = smoothIteration(i, modulus2);
+			break;
+		}
+		if(rebase)
+		{
+			/* z = Z_0 + z: the reference is of no use where it's farther from 0 than the pixel */
+			if(modulus2 < dr*dr + di*di || m == last)
+			{
+				dzr = T(zr);
+				dzi = T(zi);
+				m = 0;
+				Zr = Zi = 0.0;
+			}
+		}
+		else if(glitched && modulus2 < tolerance2*(Zr*Zr + Zi*Zi))
+		{
+			*glitched = 1;
+			break;
+		}
+	}
+	return i;
+}
+
+// dc of pixel x, and dz_i+1 past the iterations the series skips; returns i
+static inline Uint32 startPixel(int x, int first, int stride, const zFloatExp& dcX0, const zFloatExp& dcY, const zFloatExp& spanfactor, const zSeries* series, zFloatExp* dcr, zFloatExp* dci, zFloatExp* dzr, zFloatExp* dzi, zKernelStats* stats)
+{
+	*dcr = dcX0 + zFloatExp((double)(first + x*stride))*spanfactor;
+	*dci = dcY;
+	if(series && series->skip > 1)
+	{
+		evaluateSeries(series, *dcr/series->scale, *dci/series->scale, dzr, dzi);
+		stats->approximated += series->skip-1;
+		return series->skip-1; //dz_i+1 is known
+	}
+	*dzr = *dcr; //z_1 = c = C + dc
+	*dzi = *dci;
+	return 0;
+}
+
+// the rest of an orbit the reference escaped before, which is escaping too: from z_i+1 = Z_m + dz, without the reference
+template<class R>
+static inline void finishPixel(R& Z, double dzr, double dzi, double dcr, double dci, Uint32 i, Uint32 m, const zReferenceOrbit* orbit, Uint32 maxIt, double* nu)
+{
+	double Zr, Zi, zr, zi, cr, ci, tempRe, modulus2;
+
+	Z.get(m, &Zr, &Zi);
+	zr = Zr + dzr;
+	zi = Zi + dzi;
+	cr = orbit->dcr + dcr;
+	ci = orbit->dci + dci;
+	for(; i<maxIt; i++)
+	{
+		tempRe = zr*zr - zi*zi + cr;
+		zi = zr*zi*2.0 + ci;
+		zr = tempRe;
+		if((modulus2 = zr*zr + zi*zi) > RADIUS2)
+		{
+			*nu = smoothIteration(i, modulus2);
+			break;
+		}
+	}
+}
+
+// a pixel on its own, from dz_i+1
+template<class R>
+static inline void perturbPixel(R& Z, zFloatExp fdzr, zFloatExp fdzi, const zFloatExp& fdcr, const zFloatExp& fdci, Uint32 i, const zReferenceOrbit* orbit, const zBlaTable* bla, Uint32 maxIt, bool rebase, double* nu, Uint8* glitched, zKernelStats* stats)
+{
+	double dcr, dci, dzr, dzi;
+	Uint32 m = i+1;
+
+	/* differences too small for doubles are iterated in zFloatExp, only until they aren't */
+	i = perturbLoop(fdzr, fdzi, fdcr, fdci, i, m, Z, orbit, bla, maxIt, rebase, nu, glitched, stats);
+	if(*nu != NU_INSIDE || (glitched && *glitched))
+		return;
+	dcr = fdcr.toDouble();
+	dci = fdci.toDouble();
+	dzr = fdzr.toDouble();
+	dzi = fdzi.toDouble();
+	i = perturbLoop(dzr, dzi, dcr, dci, i, m, Z, orbit, bla, maxIt, rebase, nu, glitched, stats);
+	if(*nu != NU_INSIDE || (glitched && *glitched) || i >= maxIt)
+		return;
+	finishPixel(Z, dzr, dzi, dcr, dci, i, m, orbit, maxIt, nu);
+}
+
+template<class R>
+static void perturbRowWith(R Z, double* nu, Uint8* glitched, int n, int first, int stride, const zFloatExp& dcX0, const zFloatExp& dcY, const zFloatExp& spanfactor, const zReferenceOrbit* orbit, const zSeries* series, const zBlaTable* bla, Uint32 maxIt, bool rebase, zKernelStats* stats)
+{
+	zFloatExp fdcr, fdci, fdzr, fdzi;
+	zPerturbLanes group;
+	double blockRe[ORBIT_BLOCK+1], blockIm[ORBIT_BLOCK+1];
+	const double* Zr;
+	const double* Zi;
+	const int width = perturbLaneCount();
+	Uint32 last = orbit->length()-1, start = 0, i, m, count;
+	int lanes;
+
+	if(rebase)
+		glitched = NULL;
+
+	/* without bilinear approximations or rebasing every pixel goes through the reference iterations in order, so the
+	   lanes of the vector kernels can go together, sharing the loads of Z: all but the differences too small
+	   for doubles, which go on their own */
+	for(int x0=0; x0<n; x0+=width)
+	{
+		group.active = lanes = 0;
+		for(int l=0; l<width; l++)
+		{
+			int x = x0+l;
+			group.dzr[l] = group.dzi[l] = group.dcr[l] = group.dci[l] = 0.0;
+			group.nu[l] = NU_INSIDE;
+			group.glitched[l] = 0;
+			if(x >= n)
+				continue;
+			nu[x] = NU_INSIDE;
+			if(glitched)
+				glitched[x] = 0;
+			start = startPixel(x, first, stride, dcX0, dcY, spanfactor, series, &fdcr, &fdci, &fdzr, &fdzi, stats);
+			if(bla || rebase || !leavesExtendedRange(fdzr, fdzi))
+				perturbPixel(Z, fdzr, fdzi, fdcr, fdci, start, orbit, bla, maxIt, rebase, nu+x, glitched ? glitched+x : NULL, stats);
+			else
+			{
+				group.dzr[l] = fdzr.toDouble();
+				group.dzi[l] = fdzi.toDouble();
+				group.dcr[l] = fdcr.toDouble();
+				group.dci[l] = fdci.toDouble();
+				lanes |= 1<<l;
+			}
+		}
+		if(!lanes)
+			continue;
+
+		group.active = lanes;
+		i = start;
+		m = i+1;
+		while(group.active && i < maxIt && m < last)
+		{
+			count = (maxIt-i < last-m) ? maxIt-i : last-m;
+			if(count > ORBIT_BLOCK)
+				count = ORBIT_BLOCK;
+			Z.block(m, count, blockRe, blockIm, &Zr, &Zi);
+			count = perturbLanes(&group, Zr, Zi, count, i, glitched ? GLITCH_TOLERANCE*GLITCH_TOLERANCE : 0.0);
+			i += count;
+			m += count;
+		}
+		for(int l=0; l<width; l++)
+		{
+			if(!(lanes & (1<<l)))
+				continue;
+			if((group.active & (1<<l)) && i < maxIt)
+				finishPixel(Z, group.dzr[l], group.dzi[l], group.dcr[l], group.dci[l], i, m, orbit, maxIt, &group.nu[l]);
+			nu[x0+l] = group.nu[l];
+			if(glitched)
+				glitched[x0+l] = group.glitched[l];
+		}
+	}
+}
+
+void perturbRow(double* nu, Uint8* glitched, int n, int first, int stride, const zFloatExp& dcX0, const zFloatExp& dcY, const zFloatExp& spanfactor, const zReferenceOrbit* orbit, const zSeries* series, const zBlaTable* bla, Uint32 maxIt, bool rebase, zKernelStats* stats)
+{
+	if(orbit->compressed())
+		perturbRowWith(compressedOrbit(orbit), nu, glitched, n, first, stride, dcX0, dcY, spanfactor, orbit, series, bla, maxIt, rebase, stats);
+	else
+		perturbRowWith(storedOrbit(orbit), nu, glitched, n, first, stride, dcX0, dcY, spanfactor, orbit, series, bla, maxIt, rebase, stats);
+}
@@ -0,0 +1,220 @@
+/*
+zPerturb, perturbation kernels for deep zooms in zMand.
+Copyright (C) 2014  Davide Zagami
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZPERTURB_H
+#define ZPERTURB_H
+
+#include "zKernel.h"
+#include "zFixed.h"
+#include <list>
+#include <vector>
+
+//Pixel spacing, relative to the largest coordinate in view, below which double precision isn't trusted (256 double ulps)
+const double DOUBLE_MIN_SPACING = 1.0/17592186044416.0;
+
+//Whether pixels spanfactor apart anywhere in [x0, x1]x[y0, y1] can be iterated in double precision
+bool doublePrecisionSuffices(double x0, double y0, double x1, double y1, double spanfactor);
+
+//Differences from the reference below 2^DOUBLE_MIN_EXPONENT are iterated as zFloatExp, doubles would lose them to underflow
+const int DOUBLE_MIN_EXPONENT = -960;
+
+//A pixel whose orbit comes closer to 0 than this fraction of the reference orbit is glitched (Pauldelbrot's criterion):
+//its difference from the reference has lost the precision it needs
+const double GLITCH_TOLERANCE = 1e-3;
+
+//Ways to deal with glitches in deep zooms
+enum
+{
+	GLITCH_REFERENCES = 0, //glitched pixels are detected, then rendered again from extra references
+	GLITCH_REBASE, //differences restart from the beginning of the reference orbit whenever it's farther from 0 than the pixel, they never glitch
+	NUM_GLITCH_MODES
+};
+
+//Glitch mode names, for the labels
+const char* glitchModeName(int mode);
+
+
+
+//Terms of the series approximation
+const int SERIES_TERMS = 4;
+
+//Largest error of the series approximation accepted at the probe points, relative to their exact difference from the reference
+const double SERIES_TOLERANCE = 1e-9;
+
+//Largest error of a bilinear approximation step, relative to the term it leaves out
+const double BLA_TOLERANCE = 1e-9;
+
+//Shortest bilinear approximations kept are of 2^BLA_MIN_LEVEL iterations, shorter ones don't pay for looking them up
+const int BLA_MIN_LEVEL = 4;
+
+//Ways to approximate many iterations at once in deep zooms
+enum
+{
+	APPROX_NONE = 0,
+	APPROX_SERIES, //a series skips the iterations where all pixels are close to the reference
+	APPROX_BLA, //bilinear approximations skip iterations anywhere in the orbit, pixel by pixel
+	NUM_APPROX
+};
+
+//Approximation names, for the labels
+const char* approximationName(int approx);
+
+//Numeric engines a view can be rendered with, from the least general (perturbation ones last)
+enum
+{
+	ENGINE_FLOAT = 0,
+	ENGINE_DOUBLE,
+	ENGINE_DOUBLEDOUBLE,
+	ENGINE_PERTURB, //differences from a fixed-point reference orbit, in doubles
+	ENGINE_PERTURB_FLOATEXP, //same, for views whose differences start below double range
+	NUM_ENGINES
+};
+
+//Engine names, for the labels
+const char* engineName(int engine);
+
+//Estimated cost of rendering n pixels, spanfactor apart within [x0, x1]x[y0, y1], with up to maxIt iterations each,
+//in iterations of the scalar double kernel (with the kernels of the selected instruction set level).
+//HUGE_VAL if the engine can't render the view correctly, or isn't meant for it.
+double engineCost(int engine, double x0, double y0, double x1, double y1, const zFloatExp& spanfactor, int n, Uint32 maxIt);
+
+//The cheapest engine for the view, and its cost. ENGINE_FLOAT is only considered with singlePrecision:
+//a few boundary pixels escape at other iterations than in double precision (about 0.1% of the initial view).
+int selectEngine(double x0, double y0, double x1, double y1, const zFloatExp& spanfactor, int n, Uint32 maxIt, bool singlePrecision, double* cost);
+
+
+
+//Reference orbits longer than this are compressed
+const Uint32 ORBIT_COMPRESS_LENGTH = 1<<20;
+
+//Largest error of a compressed orbit, relative to |Z_n|
+const double ORBIT_TOLERANCE = 1.0/1099511627776.0;
+
+//Reference iterations decoded at a time from a compressed orbit, for pixels iterated together
+const Uint32 ORBIT_BLOCK = 1024;
+
+//Point of a compressed orbit: Z_n exactly rounded
+struct zOrbitWaypoint
+{
+	Uint32 n;
+	double re, im;
+};
+
+//Orbit of the reference point C, computed in fixed point and rounded to doubles:
+//Z_0 = 0, Z_n+1 = Z_n^2 + C.
+//Once longer than ORBIT_COMPRESS_LENGTH, only waypoints are stored: past each one the orbit is iterated again in doubles,
+//and the next waypoint is where that drifts more than ORBIT_TOLERANCE from the exact orbit. Reading it in order costs
+//an iteration in doubles per Z_n, and takes a waypoint every few dozen iterations instead of every one.
+struct zReferenceOrbit
+{
+	zFixed cr, ci; //C
+	double dcr, dci; //C rounded to doubles, for pixels that outlive the reference
+	std::vector<double> re, im; //Z_n, up to the first n where |Z_n|^2 > RADIUS2 or maxIt+1 (empty once compressed)
+	std::vector<zOrbitWaypoint> waypoints; //of the compressed orbit, the first one is Z_0
+	zFixed zr, zi; //the last Z_n in fixed point, to go on from
+	Uint32 count; //Z_n in the orbit
+	double lastRe, lastIm; //the last one
+	double driftRe, driftIm; //the last one, as read from the compressed orbit
+
+	zReferenceOrbit() : count(0), driftRe(0.0), driftIm(0.0) {}
+	Uint32 length() const;
+	bool escaped() const;
+	bool compressed() const;
+	size_t memory() const; //bytes taken by Z_n
+	void clear();
+	void append(double r, double i); //appends Z_length(), compressing the orbit if it's getting too long
+
+	private:
+		void compress(double r, double i);
+};
+
+//Computes the orbit of C = cr + ci*i, with the precision of cr rounded up to the next one zFixedN is compiled for
+void computeReference(zReferenceOrbit* orbit, const zFixed& cr, const zFixed& ci, Uint32 maxIt);
+
+//Goes on with an orbit computed for fewer iterations, up to maxIt (nothing to do if it escaped)
+void extendReference(zReferenceOrbit* orbit, Uint32 maxIt);
+
+//Reference orbits of the last views, for views that need the same ones again (panning back, zooming on a fixed center,
+//redrawing with another palette, glitches corrected at the same points)
+class zReferenceCache
+{
+	public:
+		zReferenceCache(Uint64 capacity); //bytes kept at most, over all orbits (the last one used is always kept)
+
+		//The orbit of C = cr + ci*i up to maxIt. Orbits computed for the same point with at least the same precision
+		//are reused, after extending them if they stopped short of maxIt. The orbit stays valid until the next call.
+		const zReferenceOrbit* get(const zFixed& cr, const zFixed& ci, Uint32 maxIt, bool* cached);
+		void clear();
+
+	private:
+		std::list<zReferenceOrbit> orbits; //most recently used first
+		Uint64 capacity;
+};
+
+//Newton steps allowed to converge on a nucleus without getting any closer to it
+const int NUCLEUS_MAX_STEPS = 64;
+
+//Period of the lowest-period component within radius of C = cr + ci*i, 0 if none shows up within maxIt iterations
+//(or C escapes first): the first n for which the disk, iterated n times to first order, surrounds 0.
+//The search gives up with 0 as soon as cancelled (if not NULL) returns true, it's checked every iteration.
+Uint32 findPeriod(const zFixed& cr, const zFixed& ci, const zFloatExp& radius, Uint32 maxIt, bool (*cancelled)());
+
+//Moves C = cr + ci*i to the nucleus of a component of the given period, Z_period(C) = 0, by Newton's method from C.
+//Limbs are added as long as the component needs them to be told apart. size is set to the estimated radius of the component;
+//false if Newton's method doesn't converge (C is left where it stopped), or cancelled (if not NULL) returns true before a step
+bool findNucleus(zFixed* cr, zFixed* ci, Uint32 period, zFloatExp* size, bool (*cancelled)());
+
+//Polynomial approximation of the differences from the reference orbit after skip iterations,
+//dz_skip = sum of a[k]*(dc/scale)^(k+1). The scale (the pixel spacing) keeps the coefficients close to 1.
+struct zSeries
+{
+	Uint32 skip; //1 if the series couldn't skip anything (dz_1 = dc)
+	zFloatExp scale;
+	zFloatExp ar[SERIES_TERMS], ai[SERIES_TERMS];
+};
+
+//Finds how many iterations the series approximates within SERIES_TOLERANCE for every pixel of
+//[dcX0, dcX1]x[dcY0, dcY1], checking it against the exact orbits of the corners and the edge midpoints
+void computeSeries(zSeries* series, const zReferenceOrbit* orbit, const zFloatExp& dcX0, const zFloatExp& dcY0, const zFloatExp& dcX1, const zFloatExp& dcY1, const zFloatExp& scale, Uint32 maxIt);
+
+//Bilinear approximation of 2^l iterations from Z_m: dz_m+2^l = a*dz_m + b*dc, as long as |dz_m| < r
+struct zBlaStep
+{
+	double ar, ai, br, bi, r;
+};
+
+//Bilinear approximations of the blocks of 2^l iterations aligned to 2^l, for every l >= BLA_MIN_LEVEL
+struct zBlaTable
+{
+	std::vector< std::vector<zBlaStep> > levels; //levels[l-BLA_MIN_LEVEL][j] starts from Z_1+j*2^l
+};
+
+//Builds the table along the reference orbit, for pixels up to dcMax away from the reference
+void computeBla(zBlaTable* table, const zReferenceOrbit* orbit, const zFloatExp& dcMax);
+
+//Same as escapeRow, the x-th pixel being c = C + (dcX0 + (first + x*stride)*spanfactor) + dcY*i.
+//Every pixel is iterated as a difference from the reference orbit (a zFloatExp while it's too small for doubles), starting after the
+//iterations skipped by series, and jumping ahead with the bilinear approximations in bla whenever they are valid
+//(either may be NULL). Pixels that haven't escaped when the reference does go on in plain double precision.
+//If glitched isn't NULL, glitched pixels are marked there (1, 0 for the others) and left as NU_INSIDE, to be iterated
+//again with another reference.
+//With rebase, a pixel closer to 0 than its difference from the reference (or outliving it) goes on as a difference from
+//the beginning of the orbit: z = Z_0 + dz, with Z_0 = 0. Such pixels never glitch, nor need plain double precision.
+void perturbRow(double* nu, Uint8* glitched, int n, int first, int stride, const zFloatExp& dcX0, const zFloatExp& dcY, const zFloatExp& spanfactor, const zReferenceOrbit* orbit, const zSeries* series, const zBlaTable* bla, Uint32 maxIt, bool rebase, zKernelStats* stats);
+
+#endif